@@ -0,0 +1,52 @@
+/**
+ * File: alias.cc
+ * --------------
+ * Provides the implementation of buildAliasTable.
+ */
+
+#include "alias.h"
+#include <algorithm>
+#include <math.h>
+
+/**
+ * Function: buildAliasTable
+ * -------------------------
+ * Scales every weight so the average is 1, then repeatedly pairs an
+ * underfull entry (scaled weight below 1) with an overfull one: the
+ * underfull entry keeps its own share and donates the rest of its
+ * column to the overfull entry, whose excess shrinks accordingly.
+ * Whatever remains in either worklist at the end is (up to rounding)
+ * exactly full and never defers to its alias.
+ */
+
+void buildAliasTable(const vector<double>& weights, vector<uint32_t>& threshold, vector<int32_t>& alias)
+{
+  int n = weights.size();
+  threshold.assign(n, kAlwaysKeep);
+  alias.resize(n);
+  for (int i = 0; i < n; i++) alias[i] = i;
+
+  double total = 0;
+  for (int i = 0; i < n; i++) total += weights[i];
+  if (n == 0 || total <= 0) return;
+
+  vector<double> scaled(n);
+  vector<int> underfull, overfull;
+  for (int i = 0; i < n; i++) {
+    scaled[i] = weights[i] * n / total;
+    if (scaled[i] < 1.0) underfull.push_back(i);
+    else overfull.push_back(i);
+  }
+
+  while (!underfull.empty() && !overfull.empty()) {
+    int small = underfull.back(), large = overfull.back();
+    underfull.pop_back();
+    threshold[small] = (uint32_t) min(ldexp(scaled[small], 32), (double) kAlwaysKeep - 1);
+    alias[small] = large;
+    scaled[large] -= 1.0 - scaled[small];
+    if (scaled[large] < 1.0) {
+      overfull.pop_back();
+      underfull.push_back(large);
+    }
+  }
+}
@@ -0,0 +1,56 @@
+#ifndef __alias__
+#define __alias__
+
+/**
+ * File: alias.h
+ * -------------
+ * Provides Walker's alias method for sampling from a fixed discrete
+ * distribution in constant time.  A table of n entries is built once,
+ * and each draw then costs one uniform index and (at most) one biased
+ * coin flip: entry i is kept with probability threshold[i] / 2^32,
+ * and otherwise entry alias[i] is used instead.
+ */
+
+#include <vector>
+#include <stdint.h>
+#include "random.h"
+using namespace std;
+
+/**
+ * Constant: kAlwaysKeep
+ * ---------------------
+ * The threshold recorded for entries that never defer to their alias,
+ * which lets the sampler skip the coin flip entirely.  Every entry of
+ * a uniform distribution carries this threshold.
+ */
+
+static const uint32_t kAlwaysKeep = UINT32_MAX;
+
+/**
+ * Function: buildAliasTable
+ * -------------------------
+ * Builds the alias table for the specified weights using Vose's
+ * worklist formulation of Walker's method.  The weights needn't be
+ * normalized, but none may be negative.  If they're all zero, the
+ * distribution is taken to be uniform.  threshold and alias are resized
+ * to match weights; alias entries are indices into weights.
+ */
+
+void buildAliasTable(const vector<double>& weights, vector<uint32_t>& threshold, vector<int32_t>& alias);
+
+/**
+ * Function: sampleAliasTable
+ * --------------------------
+ * Draws an index in [0, n) from the n-entry alias table addressed by
+ * threshold and alias.
+ */
+
+inline int sampleAliasTable(const uint32_t *threshold, const int32_t *alias, int n, RandomGenerator& random)
+{
+  int i = random.getRandomIndex(n);
+  uint32_t keep = threshold[i];
+  if (keep == kAlwaysKeep || (uint32_t) (random.next() >> 32) < keep) return i;
+  return alias[i];
+}
+
+#endif // ! __alias__
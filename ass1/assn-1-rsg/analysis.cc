@@ -0,0 +1,481 @@
+/**
+ * File: analysis.cc
+ * -----------------
+ * Provides the implementation of the grammar analysis.  Termination
+ * and heights come from a Knuth-style generalization of Dijkstra's
+ * algorithm over the productions.  Expected lengths come from solving
+ * E = c + M E, where M[A][B] is the expected number of times an
+ * expansion of A mentions B directly, one strongly connected component
+ * at a time, successors first.
+ */
+
+#include "analysis.h"
+#include <algorithm>
+#include <iostream>
+#include <math.h>
+#include <queue>
+
+/**
+ * Helper: getProbabilities
+ * ------------------------
+ * Normalizes the specified production weights within each definition.
+ * Definitions whose weights are all zero are treated as uniform, just
+ * as buildAliasTable treats them.
+ */
+
+static void getProbabilities(const Grammar& grammar, const vector<double>& weights, vector<double>& probabilities)
+{
+  probabilities.assign(grammar.getTotalProductions(), 0.0);
+  for (int nt = 0; nt < grammar.getNumNonterminals(); nt++) {
+    int first = grammar.getFirstProduction(nt), n = grammar.getNumProductions(nt);
+    double total = 0;
+    for (int p = first; p < first + n; p++) total += weights[p];
+    for (int p = first; p < first + n; p++)
+      probabilities[p] = total > 0 ? weights[p] / total : 1.0 / n;
+  }
+}
+
+/**
+ * Helper: computeHeights
+ * ----------------------
+ * Sets height[A] to the depth of A's shallowest complete derivation,
+ * where a production of nothing but terminals has height 1, or to -1
+ * if A can't derive a finite sentence at all.  Nonterminals are
+ * finalized in order of increasing height; each production keeps a
+ * count of the nonterminal occurrences it's still waiting on, and
+ * becomes usable the moment that count reaches zero.
+ */
+
+static void computeHeights(const Grammar& grammar, vector<int>& height)
+{
+  int numNonterminals = grammar.getNumNonterminals();
+  vector<int> waitingOn(grammar.getTotalProductions(), 0);
+  vector<vector<int> > mentionedBy(numNonterminals);
+  vector<int> owner(grammar.getTotalProductions());
+  priority_queue<pair<int, int>, vector<pair<int, int> >, greater<pair<int, int> > > ready;
+
+  for (int nt = 0; nt < numNonterminals; nt++) {
+    int first = grammar.getFirstProduction(nt);
+    for (int p = first; p < first + grammar.getNumProductions(nt); p++) {
+      owner[p] = nt;
+      for (const Grammar::symbol *s = grammar.getProductionBegin(p); s != grammar.getProductionEnd(p); s++) {
+        if (!Grammar::isNonterminal(*s)) continue;
+        mentionedBy[Grammar::getIndex(*s)].push_back(p);
+        waitingOn[p]++;
+      }
+      if (waitingOn[p] == 0) ready.push(make_pair(1, nt));
+    }
+  }
+
+  height.assign(numNonterminals, -1);
+  while (!ready.empty()) {
+    int h = ready.top().first, nt = ready.top().second;
+    ready.pop();
+    if (height[nt] != -1) continue;
+    height[nt] = h;
+    for (int i = 0; i < (int) mentionedBy[nt].size(); i++) {
+      int p = mentionedBy[nt][i];
+      if (--waitingOn[p] == 0) ready.push(make_pair(h + 1, owner[p]));
+    }
+  }
+}
+
+/**
+ * Helper: findComponents
+ * ----------------------
+ * Tarjan's strongly connected components algorithm over the graph
+ * in which A points to B if some production of A with nonzero
+ * probability mentions B.  The recursion is replaced by an explicit
+ * stack, since grammars can be arbitrarily deep.  Components are
+ * appended to components in reverse topological order: every
+ * component appears after all of the components it points to.
+ */
+
+static void findComponents(const Grammar& grammar, const vector<double>& probabilities,
+                           vector<vector<int> >& components)
+{
+  int numNonterminals = grammar.getNumNonterminals();
+  vector<vector<int> > successors(numNonterminals);
+  for (int nt = 0; nt < numNonterminals; nt++) {
+    int first = grammar.getFirstProduction(nt);
+    for (int p = first; p < first + grammar.getNumProductions(nt); p++) {
+      if (probabilities[p] == 0) continue;
+      for (const Grammar::symbol *s = grammar.getProductionBegin(p); s != grammar.getProductionEnd(p); s++)
+        if (Grammar::isNonterminal(*s)) successors[nt].push_back(Grammar::getIndex(*s));
+    }
+  }
+
+  vector<int> index(numNonterminals, -1), lowlink(numNonterminals), pending;
+  vector<bool> onStack(numNonterminals, false);
+  vector<pair<int, int> > frames;  // (nonterminal, next successor to visit)
+  int counter = 0;
+  for (int root = 0; root < numNonterminals; root++) {
+    if (index[root] != -1) continue;
+    frames.push_back(make_pair(root, 0));
+    while (!frames.empty()) {
+      int nt = frames.back().first;
+      int& next = frames.back().second;
+      if (next == 0 && index[nt] == -1) {
+        index[nt] = lowlink[nt] = counter++;
+        pending.push_back(nt);
+        onStack[nt] = true;
+      }
+
+      if (next < (int) successors[nt].size()) {
+        int succ = successors[nt][next++];
+        if (index[succ] == -1) {
+          frames.push_back(make_pair(succ, 0));
+        } else if (onStack[succ]) {
+          lowlink[nt] = min(lowlink[nt], index[succ]);
+        }
+        continue;
+      }
+
+      frames.pop_back();
+      if (!frames.empty()) {
+        int parent = frames.back().first;
+        lowlink[parent] = min(lowlink[parent], lowlink[nt]);
+      }
+      if (lowlink[nt] == index[nt]) {
+        components.push_back(vector<int>());
+        int member;
+        do {
+          member = pending.back();
+          pending.pop_back();
+          onStack[member] = false;
+          components.back().push_back(member);
+        } while (member != nt);
+      }
+    }
+  }
+}
+
+/**
+ * Struct: sparseSystem
+ * --------------------
+ * The system x = c + M x for one component, with M stored a row at a
+ * time: row i's entries are entries[rowStart[i]] up to entries[rowStart[i + 1]],
+ * one per mention of a member by a production of member i (so a column
+ * may appear more than once in a row).  That keeps the system the size
+ * of the component's productions rather than its square.
+ */
+
+struct sparseSystem {
+  vector<int> rowStart;
+  vector<pair<int, double> > entries;   // (column, coefficient)
+  vector<double> c;
+};
+
+/**
+ * Helper: solveComponent
+ * ----------------------
+ * Solves (I - M) x = c for one component, by Gaussian elimination
+ * with partial pivoting when the component is small enough, and by
+ * Gauss-Seidel iteration otherwise.  Since M and c are nonnegative, the
+ * iteration climbs monotonically toward the solution from zero when
+ * there is one and grows without bound when there isn't, so it gives up
+ * as soon as any value passes kDivergent, or after kMaxIterations sweeps.
+ * Returns false if the system is singular or the iteration doesn't settle.
+ */
+
+static bool solveComponent(const sparseSystem& system, vector<double>& x)
+{
+  const int kMaxDirectSize = 200;
+  const int kMaxIterations = 1000;
+  const double kDivergent = 1e18;
+  int n = system.c.size();
+  x.assign(n, 0.0);
+  if (n <= kMaxDirectSize) {
+    vector<vector<double> > m(n, vector<double>(n, 0.0));
+    vector<double> c = system.c;
+    for (int i = 0; i < n; i++) {
+      m[i][i] = 1.0;
+      for (int e = system.rowStart[i]; e < system.rowStart[i + 1]; e++)
+        m[i][system.entries[e].first] -= system.entries[e].second;
+    }
+    for (int col = 0; col < n; col++) {
+      int pivot = col;
+      for (int row = col + 1; row < n; row++)
+        if (fabs(m[row][col]) > fabs(m[pivot][col])) pivot = row;
+      if (fabs(m[pivot][col]) < 1e-12) return false;
+      swap(m[pivot], m[col]);
+      swap(c[pivot], c[col]);
+      for (int row = col + 1; row < n; row++) {
+        double factor = m[row][col] / m[col][col];
+        if (factor == 0) continue;
+        for (int j = col; j < n; j++) m[row][j] -= factor * m[col][j];
+        c[row] -= factor * c[col];
+      }
+    }
+    for (int row = n - 1; row >= 0; row--) {
+      double sum = c[row];
+      for (int j = row + 1; j < n; j++) sum -= m[row][j] * x[j];
+      x[row] = sum / m[row][row];
+    }
+    return true;
+  }
+
+  // a member's mentions of itself are solved for directly, rather than iterated on
+  vector<double> diagonal(n, 0.0);
+  for (int i = 0; i < n; i++) {
+    for (int e = system.rowStart[i]; e < system.rowStart[i + 1]; e++)
+      if (system.entries[e].first == i) diagonal[i] += system.entries[e].second;
+    if (diagonal[i] >= 1) return false;
+  }
+
+  for (int iteration = 0; iteration < kMaxIterations; iteration++) {
+    double change = 0;
+    for (int i = 0; i < n; i++) {
+      double value = system.c[i];
+      for (int e = system.rowStart[i]; e < system.rowStart[i + 1]; e++)
+        if (system.entries[e].first != i) value += system.entries[e].second * x[system.entries[e].first];
+      value /= 1 - diagonal[i];
+      if (!(value < kDivergent)) return false;
+      change = max(change, (value - x[i]) / max(1.0, value));
+      x[i] = value;
+    }
+    if (change < 1e-12) return true;
+  }
+  return false;
+}
+
+/**
+ * Helper: computeExpectedLengths
+ * ------------------------------
+ * Fills in expected[A] for every nonterminal, one component at a time.
+ * A component's system has a finite, meaningful solution exactly when
+ * the solution is strictly positive (or the component can't produce
+ * terminals at all, in which case it's zero); anything else means the
+ * expected number of expansions is unbounded.  Undefined and
+ * nonterminating nonterminals are unbounded by definition, and so is
+ * anything that reaches one of them with nonzero probability.
+ */
+
+static void computeExpectedLengths(const Grammar& grammar, const vector<double>& probabilities,
+                                   const vector<int>& height, vector<double>& expected)
+{
+  int numNonterminals = grammar.getNumNonterminals();
+  vector<vector<int> > components;
+  findComponents(grammar, probabilities, components);
+  expected.assign(numNonterminals, HUGE_VAL);
+  vector<int> position(numNonterminals, -1);
+  sparseSystem system;
+  vector<double> x;
+
+  for (int k = 0; k < (int) components.size(); k++) {
+    const vector<int>& members = components[k];
+    int n = members.size();
+    for (int i = 0; i < n; i++) position[members[i]] = i;
+
+    system.rowStart.assign(1, 0);
+    system.entries.clear();
+    system.c.assign(n, 0.0);
+    bool bounded = true, producesTerminals = false;
+    for (int i = 0; i < n && bounded; i++) {
+      int nt = members[i];
+      if (height[nt] == -1) bounded = false;
+      int first = grammar.getFirstProduction(nt);
+      for (int p = first; p < first + grammar.getNumProductions(nt) && bounded; p++) {
+        if (probabilities[p] == 0) continue;
+        for (const Grammar::symbol *s = grammar.getProductionBegin(p); s != grammar.getProductionEnd(p); s++) {
+          if (!Grammar::isNonterminal(*s)) {
+            system.c[i] += probabilities[p];
+          } else if (position[Grammar::getIndex(*s)] != -1) {
+            system.entries.push_back(make_pair(position[Grammar::getIndex(*s)], probabilities[p]));
+          } else {
+            system.c[i] += probabilities[p] * expected[Grammar::getIndex(*s)];
+          }
+        }
+        if (!isfinite(system.c[i])) bounded = false;
+      }
+      system.rowStart.push_back(system.entries.size());
+      if (system.c[i] > 0) producesTerminals = true;
+    }
+
+    x.assign(n, 0.0);
+    if (bounded && producesTerminals) {
+      bounded = solveComponent(system, x);
+      for (int i = 0; i < n && bounded; i++)
+        if (!(x[i] > 0) || !isfinite(x[i])) bounded = false;
+    }
+
+    for (int i = 0; i < n; i++) {
+      if (bounded) expected[members[i]] = x[i];
+      position[members[i]] = -1;
+    }
+  }
+}
+
+void analyzeGrammar(const Grammar& grammar, int start, grammarReport& report)
+{
+  int numNonterminals = grammar.getNumNonterminals();
+  report.undefined.clear();
+  report.unreachable.clear();
+  report.nonterminating.clear();
+
+  vector<bool> reachable(numNonterminals, false);
+  vector<int> frontier(1, start);
+  reachable[start] = true;
+  while (!frontier.empty()) {
+    int nt = frontier.back();
+    frontier.pop_back();
+    int first = grammar.getFirstProduction(nt);
+    for (int p = first; p < first + grammar.getNumProductions(nt); p++) {
+      for (const Grammar::symbol *s = grammar.getProductionBegin(p); s != grammar.getProductionEnd(p); s++) {
+        if (!Grammar::isNonterminal(*s) || reachable[Grammar::getIndex(*s)]) continue;
+        reachable[Grammar::getIndex(*s)] = true;
+        frontier.push_back(Grammar::getIndex(*s));
+      }
+    }
+  }
+
+  vector<int> height;
+  computeHeights(grammar, height);
+  for (int nt = 0; nt < numNonterminals; nt++) {
+    if (grammar.getNumProductions(nt) == 0) report.undefined.push_back(nt);
+    else if (!reachable[nt]) report.unreachable.push_back(nt);
+    if (grammar.getNumProductions(nt) > 0 && height[nt] == -1) report.nonterminating.push_back(nt);
+  }
+
+  report.expectedLength.clear();
+}
+
+void addExpectedLengths(const Grammar& grammar, grammarReport& report)
+{
+  vector<int> height;
+  computeHeights(grammar, height);
+  vector<double> weights(grammar.getTotalProductions()), probabilities;
+  for (int p = 0; p < grammar.getTotalProductions(); p++) weights[p] = grammar.getWeight(p);
+  getProbabilities(grammar, weights, probabilities);
+  computeExpectedLengths(grammar, probabilities, height, report.expectedLength);
+}
+
+/**
+ * Function: isDoomed
+ * ------------------
+ * Walks the nonterminals reachable from the start symbol through
+ * productions that can actually be chosen, looking for one that's
+ * undefined or can't terminate.
+ */
+
+bool isDoomed(const Grammar& grammar, int start, const grammarReport& report, string& message)
+{
+  int numNonterminals = grammar.getNumNonterminals();
+  vector<bool> broken(numNonterminals, false), reachable(numNonterminals, false);
+  for (int i = 0; i < (int) report.undefined.size(); i++) broken[report.undefined[i]] = true;
+  for (int i = 0; i < (int) report.nonterminating.size(); i++) broken[report.nonterminating[i]] = true;
+
+  // an undefined nonterminal is the root cause of everything that can't
+  // terminate because of it, so it's the one worth reporting
+  int culprit = -1;
+  vector<int> frontier(1, start);
+  reachable[start] = true;
+  while (!frontier.empty()) {
+    int nt = frontier.back();
+    frontier.pop_back();
+    if (broken[nt]) {
+      if (grammar.getNumProductions(nt) == 0) {
+        message = "Could not find \"" + string(grammar.getNonterminal(nt)) + "\" in the grammar file.";
+        return true;
+      }
+      if (culprit == -1) culprit = nt;
+    }
+    int first = grammar.getFirstProduction(nt);
+    for (int p = first; p < first + grammar.getNumProductions(nt); p++) {
+      if (grammar.getWeight(p) == 0) continue;
+      for (const Grammar::symbol *s = grammar.getProductionBegin(p); s != grammar.getProductionEnd(p); s++) {
+        if (!Grammar::isNonterminal(*s) || reachable[Grammar::getIndex(*s)]) continue;
+        reachable[Grammar::getIndex(*s)] = true;
+        frontier.push_back(Grammar::getIndex(*s));
+      }
+    }
+  }
+
+  if (culprit == -1) return false;
+  message = "\"" + string(grammar.getNonterminal(culprit)) + "\" can never expand to a finite sentence.";
+  return true;
+}
+
+static void printList(const Grammar& grammar, const char *label, const vector<int>& nonterminals, ostream& os)
+{
+  os << label << ":";
+  if (nonterminals.empty()) os << " none";
+  for (int i = 0; i < (int) nonterminals.size(); i++) os << " " << grammar.getNonterminal(nonterminals[i]);
+  os << endl;
+}
+
+void printReport(const Grammar& grammar, int start, const grammarReport& report, ostream& os)
+{
+  printList(grammar, "Undefined nonterminals", report.undefined, os);
+  printList(grammar, "Unreachable nonterminals", report.unreachable, os);
+  printList(grammar, "Nonterminating nonterminals", report.nonterminating, os);
+  os << "Expected length (in terminals) of each nonterminal:" << endl;
+  for (int nt = 0; nt < grammar.getNumNonterminals(); nt++) {
+    if (grammar.getNumProductions(nt) == 0) continue;
+    os << "    " << grammar.getNonterminal(nt) << ": ";
+    if (isfinite(report.expectedLength[nt])) os << report.expectedLength[nt] << endl;
+    else os << "unbounded" << endl;
+  }
+}
+
+/**
+ * Helper: tilt
+ * ------------
+ * Scales each production's original weight by t raised to the amount
+ * by which the production is taller than its nonterminal.  Productions
+ * that can't terminate at all get no weight.
+ */
+
+static void tilt(const Grammar& grammar, const vector<int>& excess, double t, vector<double>& weights)
+{
+  weights.resize(grammar.getTotalProductions());
+  for (int p = 0; p < grammar.getTotalProductions(); p++)
+    weights[p] = excess[p] == -1 ? 0.0 : grammar.getWeight(p) * pow(t, excess[p]);
+}
+
+bool biasTowardTermination(const Grammar& grammar, int start, double budget, vector<double>& weights)
+{
+  vector<int> height;
+  computeHeights(grammar, height);
+  vector<int> excess(grammar.getTotalProductions(), -1);
+  for (int nt = 0; nt < grammar.getNumNonterminals(); nt++) {
+    int first = grammar.getFirstProduction(nt);
+    for (int p = first; p < first + grammar.getNumProductions(nt); p++) {
+      int tallest = 0;
+      for (const Grammar::symbol *s = grammar.getProductionBegin(p); s != grammar.getProductionEnd(p); s++) {
+        if (!Grammar::isNonterminal(*s)) continue;
+        if (height[Grammar::getIndex(*s)] == -1) {
+          tallest = -1;
+          break;
+        }
+        tallest = max(tallest, height[Grammar::getIndex(*s)]);
+      }
+      if (tallest != -1 && height[nt] != -1) excess[p] = tallest + 1 - height[nt];
+    }
+  }
+
+  vector<double> probabilities, expected;
+  const double kSmallestTilt = 1e-12;
+  double low = log(kSmallestTilt), high = 0;  // bisect over log t
+  tilt(grammar, excess, 1.0, weights);
+  getProbabilities(grammar, weights, probabilities);
+  computeExpectedLengths(grammar, probabilities, height, expected);
+  if (expected[start] <= budget) return true;
+
+  tilt(grammar, excess, kSmallestTilt, weights);
+  getProbabilities(grammar, weights, probabilities);
+  computeExpectedLengths(grammar, probabilities, height, expected);
+  if (expected[start] > budget) return false;
+
+  for (int iteration = 0; iteration < 60; iteration++) {
+    double middle = (low + high) / 2;
+    tilt(grammar, excess, exp(middle), weights);
+    getProbabilities(grammar, weights, probabilities);
+    computeExpectedLengths(grammar, probabilities, height, expected);
+    if (expected[start] <= budget) low = middle;
+    else high = middle;
+  }
+
+  tilt(grammar, excess, exp(low), weights);
+  return true;
+}
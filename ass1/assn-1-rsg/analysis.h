@@ -0,0 +1,105 @@
+#ifndef __analysis__
+#define __analysis__
+
+/**
+ * File: analysis.h
+ * ----------------
+ * Defines a load-time static analysis over the graph of a compiled
+ * Grammar, where each nonterminal points to the nonterminals mentioned
+ * by its productions.  The analysis finds the problems that would
+ * otherwise only surface (or never surface) in the middle of generation:
+ * nonterminals that are used but never defined, definitions that can't
+ * be reached from the start symbol, and nonterminals from which no
+ * finite sentence can ever be derived.  It also computes the expected
+ * number of terminals each nonterminal expands to under the grammar's
+ * weights, and can re-weight a grammar whose expected sentence length
+ * is over budget so that generation is biased toward termination.
+ */
+
+#include <string>
+#include <vector>
+#include "grammar.h"
+using namespace std;
+
+/**
+ * Struct: grammarReport
+ * ---------------------
+ * The results of analyzeGrammar.  All of the lists hold nonterminal
+ * ids, in increasing order.  expectedLength is empty until
+ * addExpectedLengths fills it in; it's then indexed by nonterminal id
+ * and holds HUGE_VAL for nonterminals whose expected expansion is
+ * unbounded (including those that can't terminate at all).
+ */
+
+struct grammarReport {
+  vector<int> undefined;            // referenced but never defined
+  vector<int> unreachable;          // defined, but unreachable from the start symbol
+  vector<int> nonterminating;       // can't derive any finite sentence
+  vector<double> expectedLength;    // expected number of terminals per expansion
+};
+
+/**
+ * Function: analyzeGrammar
+ * ------------------------
+ * Runs the analysis over the specified grammar with respect
+ * to the specified start nonterminal, all but the expected lengths.
+ * It takes time roughly linear in the size of the grammar, so it's
+ * cheap enough to run on every load.
+ */
+
+void analyzeGrammar(const Grammar& grammar, int start, grammarReport& report);
+
+/**
+ * Function: addExpectedLengths
+ * ----------------------------
+ * Fills in the report's expectedLength.  This solves a linear system per
+ * strongly connected component of the grammar, which for big recursive
+ * grammars costs far more than the rest of the analysis, so it's left to
+ * the modes that need the numbers.  A component whose system doesn't
+ * settle within a fixed number of iterations is reported as unbounded.
+ */
+
+void addExpectedLengths(const Grammar& grammar, grammarReport& report);
+
+/**
+ * Function: isDoomed
+ * ------------------
+ * Returns true if the report shows that some nonterminal reachable
+ * from the start symbol is undefined or can't terminate, in which case
+ * message is set to describe the problem.  Undefined nonterminals are
+ * reported in preference to the nonterminals they keep from terminating.
+ */
+
+bool isDoomed(const Grammar& grammar, int start, const grammarReport& report, string& message);
+
+/**
+ * Function: printReport
+ * ---------------------
+ * Writes a human-readable version of the report, which must have
+ * its expected lengths filled in, to the specified stream.
+ */
+
+void printReport(const Grammar& grammar, int start, const grammarReport& report, ostream& os);
+
+/**
+ * Function: biasTowardTermination
+ * -------------------------------
+ * Computes production weights under which the expected length of the
+ * start symbol is at most budget.  Every production is tilted by
+ * t^(height of the production - height of its nonterminal), where
+ * the height of a nonterminal is the depth of its shallowest complete
+ * derivation.  Productions that make progress toward termination keep
+ * their weight while the others are scaled down, and t is found by
+ * bisection.  Returns false if no tilt meets the budget; weights then
+ * holds the most strongly biased weights tried.
+ *
+ * @param grammar the grammar to re-weight.
+ * @param start the start nonterminal, which must be able to terminate.
+ * @param budget the largest acceptable expected length.
+ * @param weights set to the new weight of every production.
+ * @return true if and only if the budget could be met.
+ */
+
+bool biasTowardTermination(const Grammar& grammar, int start, double budget, vector<double>& weights);
+
+#endif // ! __analysis__
@@ -0,0 +1,217 @@
+/**
+ * File: batch.cc
+ * --------------
+ * Provides the implementation of the batch generation mode.
+ * Workers never touch stdout in ordered mode: they deposit finished
+ * chunks into a small ring of slots, and the calling thread drains
+ * the ring in chunk order.  Workers are never allowed to run more
+ * than a ring's worth of chunks ahead of the writer, so memory use
+ * is bounded no matter how many sentences are requested.  Whenever
+ * the writer wakes up, it hands every consecutive finished chunk
+ * to a single writev.
+ */
+
+#include "batch.h"
+#include "generator.h"
+#include "output.h"
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+static const int kSlotsPerThread = 4;
+
+/**
+ * Struct: batchState
+ * ------------------
+ * Everything the workers and the writer share.  All fields
+ * are guarded by lock.
+ */
+
+struct batchState {
+  const Grammar *grammar;
+  int start;
+  const batchOptions *opts;
+  long numChunks;
+
+  mutex lock;
+  condition_variable chunkReady;   // signaled by workers when a slot fills
+  condition_variable slotFree;     // signaled by the writer when a slot drains
+  long nextChunk;                  // next chunk to be claimed by a worker
+  long nextToWrite;                // next chunk the writer is waiting on
+  vector<OutputBuffer> slots;
+  vector<bool> ready;
+  bool failed;
+  long failedChunk;                // the first chunk to fail, or numChunks
+  string error;                    // why failedChunk failed
+};
+
+/**
+ * Function: fillChunk
+ * -------------------
+ * Generates every sentence of the specified chunk into buffer, one per
+ * line.  The Generator is switched to the chunk's own random stream, so the
+ * contents of a chunk don't depend on which worker happened to claim it.
+ */
+
+static bool fillChunk(batchState& state, Generator& generator, long chunk, OutputBuffer& buffer)
+{
+  buffer.clear();
+  long first = chunk * kSentencesPerChunk;
+  long last = min(first + kSentencesPerChunk, state.opts->count);
+  return generateSentences(generator, state.start, state.opts->seed, first, last, buffer);
+}
+
+/**
+ * Function: generateSentences
+ * ---------------------------
+ * Sentence i is drawn from stream i / kSentencesPerChunk, picking
+ * up wherever sentence i - 1 left that stream, so a range that starts
+ * in the middle of a chunk first replays the part of the chunk before it.
+ */
+
+bool generateSentences(Generator& generator, int start, uint64_t seed, long first, long last, OutputBuffer& out)
+{
+  long i = first - first % kSentencesPerChunk;
+  size_t mark = out.size();
+  while (i < last) {
+    if (i % kSentencesPerChunk == 0) generator.seed(seed, i / kSentencesPerChunk);
+    if (!generator.generate(start, out)) return false;
+    if (i < first) out.truncate(mark);
+    else out.append('\n');
+    i++;
+  }
+
+  return true;
+}
+
+/**
+ * Function: worker
+ * ----------------
+ * Thread routine: repeatedly claims the next chunk, fills it, and
+ * either parks it in the ring (ordered mode) or writes it directly
+ * (unordered mode).  Returns once every chunk has been claimed or
+ * some worker has failed.
+ */
+
+static void worker(batchState *state)
+{
+  const batchOptions& opts = *state->opts;
+  Generator generator(*state->grammar, opts.maxDepth, opts.maxLength);
+  OutputBuffer buffer;
+  long numSlots = state->slots.size();
+
+  while (true) {
+    long chunk;
+    {
+      unique_lock<mutex> guard(state->lock);
+      if (!opts.unordered) {
+        while (!state->failed && state->nextChunk < state->numChunks &&
+               state->nextChunk >= state->nextToWrite + numSlots)
+          state->slotFree.wait(guard);
+      }
+      if (state->failed || state->nextChunk == state->numChunks) return;
+      chunk = state->nextChunk++;
+    }
+
+    bool succeeded = fillChunk(*state, generator, chunk, buffer);
+    unique_lock<mutex> guard(state->lock);
+    if (!succeeded) {
+      if (chunk < state->failedChunk) {
+        state->failedChunk = chunk;
+        state->error = generator.getError();
+      }
+      state->failed = true;
+      state->chunkReady.notify_all();
+      state->slotFree.notify_all();
+      return;
+    }
+
+    if (opts.unordered) {
+      const OutputBuffer *chunkBuffer = &buffer;
+      writeBuffers(STDOUT_FILENO, &chunkBuffer, 1);  // still holding the lock, so chunks never interleave
+    } else {
+      state->slots[chunk % numSlots].swap(buffer);
+      state->ready[chunk % numSlots] = true;
+      state->chunkReady.notify_all();
+    }
+  }
+}
+
+/**
+ * Function: countReadyChunks
+ * --------------------------
+ * Stops after one trip around the ring: once every slot is ready, chunk
+ * + ready.size() maps back onto chunk's own slot, which holds chunk, not
+ * that later one.
+ */
+
+long countReadyChunks(const vector<bool>& ready, long chunk, long numChunks)
+{
+  long numSlots = ready.size();
+  long c = chunk;
+  while (c < numChunks && c < chunk + numSlots && ready[c % numSlots]) c++;
+  return c - chunk;
+}
+
+/**
+ * Function: generateBatch
+ * -----------------------
+ * Spawns the workers and, in ordered mode, drains the ring on
+ * the calling thread.  Buffers are swapped rather than copied into
+ * the ring, so their capacity is recycled from chunk to chunk.
+ */
+
+bool generateBatch(const Grammar& grammar, int start, const batchOptions& opts, string& error)
+{
+  batchState state;
+  state.grammar = &grammar;
+  state.start = start;
+  state.opts = &opts;
+  state.numChunks = (opts.count + kSentencesPerChunk - 1) / kSentencesPerChunk;
+  state.nextChunk = 0;
+  state.nextToWrite = 0;
+  state.slots = vector<OutputBuffer>(opts.numThreads * kSlotsPerThread);
+  state.ready.resize(state.slots.size(), false);
+  state.failed = false;
+  state.failedChunk = state.numChunks;
+
+  vector<thread> workers;
+  for (int i = 0; i < opts.numThreads; i++)
+    workers.push_back(thread(worker, &state));
+
+  if (!opts.unordered) {
+    long numSlots = state.slots.size();
+    vector<const OutputBuffer *> finished;
+    long chunk = 0;
+    while (chunk < state.numChunks) {
+      {
+        // every chunk before the first failure was claimed before it,
+        // so each will turn up (or fail, moving failedChunk back)
+        unique_lock<mutex> guard(state.lock);
+        while (chunk < state.failedChunk && !state.ready[chunk % numSlots])
+          state.chunkReady.wait(guard);
+        if (chunk >= state.failedChunk) break;
+        finished.clear();
+        long numReady = countReadyChunks(state.ready, chunk, state.failedChunk);
+        for (long c = chunk; c < chunk + numReady; c++)
+          finished.push_back(&state.slots[c % numSlots]);
+      }
+
+      // no worker can claim these slots until nextToWrite moves past them,
+      // so they're safe to read without the lock
+      writeBuffers(STDOUT_FILENO, finished.data(), finished.size());
+      unique_lock<mutex> guard(state.lock);
+      for (int i = 0; i < (int) finished.size(); i++, chunk++)
+        state.ready[chunk % numSlots] = false;
+      state.nextToWrite = chunk;
+      state.slotFree.notify_all();
+    }
+  }
+
+  for (int i = 0; i < (int) workers.size(); i++)
+    workers[i].join();
+  error = state.error;
+  return !state.failed;
+}
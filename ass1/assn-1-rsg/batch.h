@@ -0,0 +1,87 @@
+#ifndef __batch__
+#define __batch__
+
+/**
+ * File: batch.h
+ * -------------
+ * Defines the batch generation mode, which produces a large number
+ * of sentences, one per line, by sharding the work across a pool of
+ * worker threads.  The sentences are divided into fixed-size chunks;
+ * each worker claims a chunk, expands it into a private buffer using
+ * its own Generator (and therefore its own random stream), and hands
+ * the buffer off to be written to stdout.
+ */
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include "grammar.h"
+#include "generator.h"
+#include "output.h"
+using namespace std;
+
+/**
+ * Constant: kSentencesPerChunk
+ * ----------------------------
+ * The number of consecutive sentences drawn from each random stream.
+ * Anything that wants to reproduce rsg -n's output (the programs written
+ * by --emit-cpp, for instance) has to switch streams at the same places.
+ */
+
+static const long kSentencesPerChunk = 4096;
+
+/**
+ * Struct: batchOptions
+ * --------------------
+ * Bundles the parameters of a batch run.  If unordered is false,
+ * chunks are written in the order they were claimed, so the output
+ * is laid out exactly as a single-threaded run would lay it out.
+ * If unordered is true, each chunk is written as soon as it's done.
+ */
+
+struct batchOptions {
+  long count;          // total number of sentences
+  int numThreads;      // number of worker threads
+  bool unordered;      // write chunks as they complete
+  int maxDepth;        // passed along to each Generator
+  long maxLength;      // passed along to each Generator
+  uint64_t seed;       // chunk i draws from stream i of this seed
+};
+
+/**
+ * Function: generateBatch
+ * -----------------------
+ * Generates opts.count sentences from the specified start nonterminal and
+ * writes them to stdout.  Returns true if every sentence was generated, and
+ * false otherwise, in which case error describes the failure in the earliest
+ * chunk that failed.  In ordered mode, exactly the chunks before that one
+ * have been written, however the work was divided among the workers.
+ */
+
+bool generateBatch(const Grammar& grammar, int start, const batchOptions& opts, string& error);
+
+/**
+ * Function: generateSentences
+ * ---------------------------
+ * Appends sentences first through last - 1 of the sequence a batch
+ * run with the specified seed would produce to out, one per line,
+ * using the specified Generator (which is reseeded along the way).
+ * This is what lets other front ends, like the --serve daemon, produce
+ * exactly the sentences rsg -n would.  Returns false on the first
+ * failure, which the Generator's getError describes.
+ */
+
+bool generateSentences(Generator& generator, int start, uint64_t seed, long first, long last, OutputBuffer& out);
+
+/**
+ * Function: countReadyChunks
+ * --------------------------
+ * Returns how many consecutive chunks, starting with the specified one,
+ * are waiting in a ring of ready.size() slots, where chunk c lives in slot
+ * c % ready.size() and ready says which slots are full.  Never counts past
+ * numChunks, or past one full ring.
+ */
+
+long countReadyChunks(const vector<bool>& ready, long chunk, long numChunks);
+
+#endif // ! __batch__
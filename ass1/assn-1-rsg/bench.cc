@@ -0,0 +1,303 @@
+/**
+ * File: bench.cc
+ * --------------
+ * Provides the implementation of rsg-bench, a microbenchmark for the
+ * two halves of rsg: turning a grammar file into a compiled Grammar,
+ * and expanding <start> into sentences.  For every grammar named on
+ * the command line it reports
+ *
+ *    load_ms              median time for loadGrammar, which is how rsg
+ *                         reads the file (text or image)
+ *    parse_ms             median time for the original stream-based
+ *                         reader to build Definitions out of the text
+ *    compile_ms           median time to build the Grammar from them
+ *                         (both are 0 for an image)
+ *    sentences_per_sec    and bytes_per_sec, over the whole run
+ *    allocs_per_sentence  calls to operator new during generation
+ *    p50_us, p99_us       per-sentence latency percentiles
+ *
+ * as one CSV row (or one JSON object with --json), so runs can be
+ * diffed or fed to a plotting script to spot regressions.
+ */
+
+#include "loader.h"
+#include "grammar.h"
+#include "generator.h"
+#include "output.h"
+#include "analysis.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <vector>
+#include <stdio.h>
+#include <time.h>
+using namespace std;
+
+/**
+ * Every allocation made through operator new (and hence through
+ * new[], the containers and string) bumps this counter, which is
+ * how allocs_per_sentence is measured.
+ */
+
+static atomic<long> numAllocations(0);
+
+void *operator new(size_t size)
+{
+  numAllocations.fetch_add(1, memory_order_relaxed);
+  void *p = malloc(size == 0 ? 1 : size);
+  if (p == NULL) throw bad_alloc();
+  return p;
+}
+
+void operator delete(void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+
+/**
+ * Struct: benchOptions
+ * --------------------
+ * Bundles everything the user may specify on the command line.
+ */
+
+struct benchOptions {
+  long count;           // sentences generated per grammar
+  int repetitions;      // times each grammar is parsed and compiled
+  uint64_t seed;
+  int maxDepth;
+  long maxLength;
+  bool json;
+  vector<const char *> grammarFileNames;
+};
+
+/**
+ * Struct: benchResult
+ * -------------------
+ * One grammar's measurements.  status is "ok", or says why the
+ * grammar couldn't be benchmarked, in which case the remaining
+ * fields are zero.
+ */
+
+struct benchResult {
+  const char *grammarFileName;
+  string status;
+  double loadMillis;
+  double parseMillis;
+  double compileMillis;
+  long sentences;
+  long failures;        // sentences that hit the depth or length cap
+  double sentencesPerSecond;
+  double bytesPerSecond;
+  double allocationsPerSentence;
+  double p50Micros;
+  double p99Micros;
+};
+
+static uint64_t now()
+{
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static double median(vector<uint64_t>& samples)
+{
+  sort(samples.begin(), samples.end());
+  return samples[samples.size() / 2];
+}
+
+/**
+ * Loads the grammar opts.repetitions times, keeping the last copy, and
+ * times the original readGrammar-and-compile route just as often for
+ * comparison.  Returns NULL if the file can't be loaded at all.
+ */
+
+static Grammar *timeLoad(const char *fileName, const benchOptions& opts, benchResult& result)
+{
+  vector<uint64_t> loadTimes, parseTimes, compileTimes;
+  unique_ptr<Grammar> grammar;
+  for (int i = 0; i < opts.repetitions; i++) {
+    uint64_t start = now();
+    grammar.reset(loadGrammar(fileName));
+    if (grammar == NULL) return NULL;
+    loadTimes.push_back(now() - start);
+    if (Grammar::isImageFile(fileName)) continue;
+
+    start = now();
+    ifstream infile(fileName);
+    map<string, Definition> definitions;
+    readGrammar(infile, definitions);
+    uint64_t parsed = now();
+    Grammar compiled(definitions);
+    parseTimes.push_back(parsed - start);
+    compileTimes.push_back(now() - parsed);
+  }
+
+  result.loadMillis = median(loadTimes) / 1e6;
+  if (!parseTimes.empty()) {
+    result.parseMillis = median(parseTimes) / 1e6;
+    result.compileMillis = median(compileTimes) / 1e6;
+  }
+  return grammar.release();
+}
+
+/**
+ * Generates opts.count sentences into a detached buffer, timing each
+ * one.  The buffer is emptied whenever it gets big so that the numbers
+ * reflect expansion rather than page faults.
+ */
+
+static void timeGeneration(const Grammar& grammar, int start, const benchOptions& opts, benchResult& result)
+{
+  Generator generator(grammar, opts.maxDepth, opts.maxLength);
+  generator.seed(opts.seed);
+  OutputBuffer out;
+  vector<uint64_t> latencies(opts.count);
+  uint64_t bytes = 0;
+  result.failures = 0;
+
+  long allocationsBefore = numAllocations.load();
+  uint64_t begin = now();
+  for (long i = 0; i < opts.count; i++) {
+    uint64_t sentenceStart = now();
+    size_t mark = out.size();
+    if (!generator.generate(start, out)) result.failures++;
+    out.append('\n');
+    latencies[i] = now() - sentenceStart;
+    bytes += out.size() - mark;
+    if (out.size() >= OutputBuffer::kDefaultCapacity / 2) out.clear();
+  }
+  double seconds = (now() - begin) / 1e9;
+  long allocations = numAllocations.load() - allocationsBefore;
+
+  sort(latencies.begin(), latencies.end());
+  result.sentences = opts.count;
+  result.sentencesPerSecond = opts.count / seconds;
+  result.bytesPerSecond = bytes / seconds;
+  result.allocationsPerSentence = (double) allocations / opts.count;
+  result.p50Micros = latencies[opts.count / 2] / 1e3;
+  result.p99Micros = latencies[opts.count * 99 / 100] / 1e3;
+}
+
+static void benchmark(const char *fileName, const benchOptions& opts, benchResult& result)
+{
+  result = benchResult();
+  result.grammarFileName = fileName;
+  unique_ptr<Grammar> grammar(timeLoad(fileName, opts, result));
+  if (grammar == NULL) {
+    result.status = "unreadable";
+    return;
+  }
+
+  int start = grammar->lookupNonterminal("<start>");
+  if (start == -1) {
+    result.status = "no <start>";
+    return;
+  }
+
+  grammarReport report;
+  analyzeGrammar(*grammar, start, report);
+  string problem;
+  if (isDoomed(*grammar, start, report, problem)) {
+    result.status = "doomed";
+    return;
+  }
+
+  result.status = "ok";
+  timeGeneration(*grammar, start, opts, result);
+}
+
+static void printCSV(const vector<benchResult>& results)
+{
+  printf("grammar,status,load_ms,parse_ms,compile_ms,sentences,failures,sentences_per_sec,"
+         "bytes_per_sec,allocs_per_sentence,p50_us,p99_us\n");
+  for (const benchResult& r : results) {
+    printf("%s,%s,%.3f,%.3f,%.3f,%ld,%ld,%.0f,%.0f,%.2f,%.3f,%.3f\n",
+           r.grammarFileName, r.status.c_str(), r.loadMillis, r.parseMillis, r.compileMillis,
+           r.sentences, r.failures, r.sentencesPerSecond, r.bytesPerSecond,
+           r.allocationsPerSentence, r.p50Micros, r.p99Micros);
+  }
+}
+
+static void printJSON(const vector<benchResult>& results)
+{
+  printf("[\n");
+  for (size_t i = 0; i < results.size(); i++) {
+    const benchResult& r = results[i];
+    printf("  {\"grammar\": \"%s\", \"status\": \"%s\", \"load_ms\": %.3f, \"parse_ms\": %.3f, \"compile_ms\": %.3f, "
+           "\"sentences\": %ld, \"failures\": %ld, \"sentences_per_sec\": %.0f, \"bytes_per_sec\": %.0f, "
+           "\"allocs_per_sentence\": %.2f, \"p50_us\": %.3f, \"p99_us\": %.3f}%s\n",
+           r.grammarFileName, r.status.c_str(), r.loadMillis, r.parseMillis, r.compileMillis,
+           r.sentences, r.failures, r.sentencesPerSecond, r.bytesPerSecond,
+           r.allocationsPerSentence, r.p50Micros, r.p99Micros, i + 1 < results.size() ? "," : "");
+  }
+  printf("]\n");
+}
+
+/**
+ * Fills in opts from the command line, which takes these flags,
+ * followed by any number of grammar files (text or image):
+ *
+ *    -n COUNT          sentences generated per grammar (default 5000)
+ *    -r COUNT          times each grammar is parsed (default 10)
+ *    --seed S          seed for the generator (default 1)
+ *    --max-depth N     as for rsg
+ *    --max-length N    as for rsg
+ *    --json            write JSON instead of CSV
+ *
+ * Returns false if the command line is malformed.
+ */
+
+static bool parseOptions(int argc, char *argv[], benchOptions& opts)
+{
+  opts.count = 5000;
+  opts.repetitions = 10;
+  opts.seed = 1;
+  opts.maxDepth = Generator::kDefaultMaxDepth;
+  opts.maxLength = Generator::kDefaultMaxLength;
+  opts.json = false;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+      opts.count = atol(argv[++i]);
+      if (opts.count <= 0) return false;
+    } else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+      opts.repetitions = atoi(argv[++i]);
+      if (opts.repetitions <= 0) return false;
+    } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+      opts.seed = strtoull(argv[++i], NULL, 0);
+    } else if (strcmp(argv[i], "--max-depth") == 0 && i + 1 < argc) {
+      opts.maxDepth = atoi(argv[++i]);
+      if (opts.maxDepth <= 0) return false;
+    } else if (strcmp(argv[i], "--max-length") == 0 && i + 1 < argc) {
+      opts.maxLength = atol(argv[++i]);
+      if (opts.maxLength <= 0) return false;
+    } else if (strcmp(argv[i], "--json") == 0) {
+      opts.json = true;
+    } else if (argv[i][0] == '-') {
+      return false;
+    } else {
+      opts.grammarFileNames.push_back(argv[i]);
+    }
+  }
+
+  return !opts.grammarFileNames.empty();
+}
+
+int main(int argc, char *argv[])
+{
+  benchOptions opts;
+  if (!parseOptions(argc, argv, opts)) {
+    fprintf(stderr, "Usage: rsg-bench [-n COUNT] [-r COUNT] [--seed S] [--max-depth N] [--max-length N] [--json] <grammar file> ...\n");
+    return 1;
+  }
+
+  vector<benchResult> results(opts.grammarFileNames.size());
+  for (size_t i = 0; i < results.size(); i++)
+    benchmark(opts.grammarFileNames[i], opts, results[i]);
+
+  if (opts.json) printJSON(results);
+  else printCSV(results);
+  return 0;
+}
@@ -0,0 +1,41 @@
+#!/bin/sh
+#
+# Checks that programs written by rsg --emit-cpp write exactly what
+# rsg -n writes for the same seed, using a grammar whose right recursion
+# runs far deeper than --max-depth (legal, since tail calls don't add to
+# the depth).  With a slightly smaller --max-depth, generation fails
+# partway through, and both must write the same whole chunks first.
+#
+# Usage: check-emitter.sh [path to rsg]
+
+RSG=${1:-./rsg}
+CXX=${CXX:-g++}
+SRC=$(dirname "$0")
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+status=0
+
+check() {
+  description=$1; grammar=$2; shift 2
+  if ! "$RSG" --emit-cpp "$@" "$grammar" -o "$TMP/program.cc" ||
+     ! $CXX -O2 -std=c++17 -I "$SRC" -o "$TMP/program" "$TMP/program.cc" "$SRC/random.cc"; then
+    echo "FAIL $description (couldn't build the emitted program)"
+    status=1
+    return
+  fi
+  "$RSG" -n 40000 --seed 7 "$@" "$grammar" > "$TMP/expected" 2> "$TMP/expected.err"
+  expectedStatus=$?
+  "$TMP/program" -n 40000 --seed 7 > "$TMP/actual" 2> "$TMP/actual.err"
+  actualStatus=$?
+  if [ $expectedStatus -ne $actualStatus ] ||
+     ! cmp -s "$TMP/expected" "$TMP/actual" || ! cmp -s "$TMP/expected.err" "$TMP/actual.err"; then
+    echo "FAIL $description"
+    status=1
+  else
+    echo "PASS $description"
+  fi
+}
+
+check "emitted programs count tail calls as rsg does" "$SRC/data/right-recursive.g" --max-depth 13
+check "emitted programs fail where rsg does, writing the same chunks" "$SRC/data/right-recursive.g" --max-depth 11
+exit $status
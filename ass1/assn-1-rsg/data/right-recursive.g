@@ -0,0 +1,162 @@
+A grammar whose sentences are long right-recursive lists, for checking
+that everything counts the depth of tail calls the way rsg does.  Now
+and then an item is itself a list, in parentheses, which isn't a tail
+call, so a small enough --max-depth fails every so often.
+
+{
+<start>
+<list> .	;
+}
+
+{
+<list>
+<item> <list>	;
+<item> <list>	;
+<item> <list>	;
+<item> <list>	;
+<item> <list>	;
+<item> <list>	;
+<item> <list>	;
+<item> <list>	;
+<item> <list>	;
+<item> <list>	;
+<item> <list>	;
+<item> <list>	;
+<item> <list>	;
+<item> <list>	;
+<item> <list>	;
+<item> <list>	;
+<item> <list>	;
+<item> <list>	;
+<item> <list>	;
+<item> <list>	;
+<item>	;
+}
+
+{
+<item>
+( <list> )	;
+ham	;
+eggs	;
+spam	;
+ham	;
+eggs	;
+spam	;
+ham	;
+eggs	;
+spam	;
+ham	;
+eggs	;
+spam	;
+ham	;
+eggs	;
+spam	;
+ham	;
+eggs	;
+spam	;
+ham	;
+eggs	;
+spam	;
+ham	;
+eggs	;
+spam	;
+ham	;
+eggs	;
+spam	;
+ham	;
+eggs	;
+spam	;
+ham	;
+eggs	;
+spam	;
+ham	;
+eggs	;
+spam	;
+ham	;
+eggs	;
+spam	;
+ham	;
+eggs	;
+spam	;
+ham	;
+eggs	;
+spam	;
+ham	;
+eggs	;
+spam	;
+ham	;
+eggs	;
+spam	;
+ham	;
+eggs	;
+spam	;
+ham	;
+eggs	;
+spam	;
+ham	;
+eggs	;
+spam	;
+ham	;
+eggs	;
+spam	;
+ham	;
+eggs	;
+spam	;
+ham	;
+eggs	;
+spam	;
+ham	;
+eggs	;
+spam	;
+ham	;
+eggs	;
+spam	;
+ham	;
+eggs	;
+spam	;
+ham	;
+eggs	;
+spam	;
+ham	;
+eggs	;
+spam	;
+ham	;
+eggs	;
+spam	;
+ham	;
+eggs	;
+spam	;
+ham	;
+eggs	;
+spam	;
+ham	;
+eggs	;
+spam	;
+ham	;
+eggs	;
+spam	;
+ham	;
+eggs	;
+spam	;
+ham	;
+eggs	;
+spam	;
+ham	;
+eggs	;
+spam	;
+ham	;
+eggs	;
+spam	;
+ham	;
+eggs	;
+spam	;
+ham	;
+eggs	;
+spam	;
+ham	;
+eggs	;
+spam	;
+ham	;
+eggs	;
+spam	;
+}
@@ -8,7 +8,7 @@
  */ 
  
 #include "definition.h"
-#include "random.h"
+#include "alias.h"
 
 /**
  * Constructor: Definition
@@ -19,6 +19,8 @@
  * constructor which also takes an ifstream reference.
  * The strong assumption is that the file reference is
  * poised to read the opening '{' as the very first character.
+ * Once all of the Productions are in, the alias table
+ * used by getRandomProduction is built from their weights.
  */
 
 Definition::Definition(ifstream& infile)
@@ -34,6 +36,11 @@ Definition::Definition(ifstream& infile)
   }
   
   getline(infile, uselessText, '}');
+
+  vector<double> weights;
+  for (int i = 0; i < (int) possibleExpansions.size(); i++)
+    weights.push_back(possibleExpansions[i].getWeight());
+  buildAliasTable(weights, aliasThreshold, alias);
 }
 
 /**
@@ -41,13 +48,13 @@ Definition::Definition(ifstream& infile)
  * ---------------------------
  * Returns a const reference to one of the
  * embedded Productions.  Relies on the
- * correct implementation of the RandomNumberGenerator
- * class, but is otherwise a no-brainer.
+ * correct implementation of the RandomGenerator
+ * class, but is otherwise a no-brainer.  The caller
+ * supplies the generator, so there is no shared state.
  */
 
-const Production& Definition::getRandomProduction() const
+const Production& Definition::getRandomProduction(RandomGenerator& random) const
 {
-  static RandomGenerator random; 
-  int randomIndex = random.getRandomInteger(0, possibleExpansions.size() - 1);
+  int randomIndex = sampleAliasTable(aliasThreshold.data(), alias.data(), possibleExpansions.size(), random);
   return possibleExpansions[randomIndex];
 }
@@ -11,7 +11,9 @@
  */
 
 #include "production.h"
+#include "random.h"
 #include <vector>
+#include <stdint.h>
 using namespace std;  
 
 class Definition {
@@ -80,18 +82,35 @@ class Definition {
    * ---------------------------
    * Returns an immutable reference to one and
    * exactly one of the Definition's expansions.
-   * The Production is chosen at random.
+   * The Production is chosen at random, with probability
+   * proportional to its weight, in constant time.
    *
+   * @param random the generator supplying the randomness.
    * @return an immutable reference to a randomly selected
    *         Production held by the Definition.  It is assumed
    *         that the Definition has at least one Production.
    */
   
-  const Production& getRandomProduction() const;
+  const Production& getRandomProduction(RandomGenerator& random) const;
+
+  /**
+   * Iterators: begin, end
+   * ---------------------
+   * Provides read-only, STL-like iterator access to the
+   * sequence of Productions, in the order they appeared
+   * in the grammar file.  The Grammar class relies on these
+   * to compile the Definition down to integer symbol ids.
+   */
+
+  typedef vector<Production>::const_iterator const_iterator;
+  const_iterator begin() const { return possibleExpansions.begin(); }
+  const_iterator end() const { return possibleExpansions.end(); }
   
  private:
   string nonterminal;
   vector<Production> possibleExpansions;
+  vector<uint32_t> aliasThreshold;   // alias table over possibleExpansions' weights
+  vector<int32_t> alias;
 };
 
 #endif // ! __definition__
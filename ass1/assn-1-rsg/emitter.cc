@@ -0,0 +1,244 @@
+/**
+ * File: emitter.cc
+ * ----------------
+ * Provides the implementation of emitCpp.  The emitted program is
+ * written in three parts: a fixed prologue (the output buffer and
+ * error handling every program needs), one function per nonterminal,
+ * and a fixed main.  Nonterminal n becomes expandn, so names in the
+ * grammar never have to be turned into identifiers; they appear only
+ * in comments and error messages.
+ */
+
+#include "emitter.h"
+#include "batch.h"
+#include <stdio.h>
+#include <string>
+using namespace std;
+
+/**
+ * Function: quote
+ * ---------------
+ * Returns the specified text as a C++ string literal.  Anything
+ * unprintable is written as a three-digit octal escape, so that a
+ * following digit can't be mistaken for part of it.
+ */
+
+static string quote(string_view text)
+{
+  string literal = "\"";
+  for (size_t i = 0; i < text.size(); i++) {
+    unsigned char ch = text[i];
+    if (ch == '"' || ch == '\\') {
+      literal += '\\';
+      literal += ch;
+    } else if (ch < ' ' || ch >= 0x7f || ch == '?') {   // '?' dodges trigraphs
+      char escape[8];
+      sprintf(escape, "\\%03o", ch);
+      literal += escape;
+    } else {
+      literal += ch;
+    }
+  }
+
+  return literal + "\"";
+}
+
+static const char *const kPrologue =
+  "#include <string>\n"
+  "#include <string_view>\n"
+  "#include <stdint.h>\n"
+  "#include <stdio.h>\n"
+  "#include <stdlib.h>\n"
+  "#include <string.h>\n"
+  "#include <time.h>\n"
+  "#include \"random.h\"\n"
+  "#include \"alias.h\"\n"
+  "using namespace std;\n"
+  "\n"
+  "static RandomGenerator generator;\n"
+  "static string out;          // sentences not yet written to stdout\n"
+  "static long length;         // terminals in the current sentence\n"
+  "static bool first;          // true until the current sentence has a terminal\n"
+  "static string error;\n"
+  "\n"
+  "static bool emit(int terminal)\n"
+  "{\n"
+  "  if (++length > kMaxLength) {\n"
+  "    error = \"Expansion exceeded the maximum length of \" + to_string(kMaxLength) + \" terminals.\";\n"
+  "    return false;\n"
+  "  }\n"
+  "  if (!first) out += ' ';\n"
+  "  out.append(kTerminals[terminal]);\n"
+  "  first = false;\n"
+  "  return true;\n"
+  "}\n"
+  "\n"
+  "[[maybe_unused]] static bool undefined(const char *nonterminal)\n"
+  "{\n"
+  "  error = string(\"Could not find \\\"\") + nonterminal + \"\\\" in the grammar file.\";\n"
+  "  return false;\n"
+  "}\n"
+  "\n"
+  "static bool tooDeep(const char *nonterminal)\n"
+  "{\n"
+  "  error = \"Expansion exceeded the maximum depth of \" + to_string(kMaxDepth) +\n"
+  "          \" pending productions while expanding \\\"\" + nonterminal + \"\\\".\";\n"
+  "  return false;\n"
+  "}\n"
+  "\n";
+
+static const char *const kMain =
+  "\n"
+  "static void drain()\n"
+  "{\n"
+  "  fwrite(out.data(), 1, out.size(), stdout);\n"
+  "  out.clear();\n"
+  "}\n"
+  "\n"
+  "static bool generate()\n"
+  "{\n"
+  "  size_t mark = out.size();\n"
+  "  length = 0;\n"
+  "  first = true;\n"
+  "  if (expandStart(0)) return true;\n"
+  "  out.resize(mark);\n"
+  "  return false;\n"
+  "}\n"
+  "\n"
+  "int main(int argc, char *argv[])\n"
+  "{\n"
+  "  long count = 0;\n"
+  "  uint64_t seed = time(NULL);\n"
+  "  for (int i = 1; i < argc; i++) {\n"
+  "    if (strcmp(argv[i], \"-n\") == 0 && i + 1 < argc) {\n"
+  "      count = atol(argv[++i]);\n"
+  "    } else if (strcmp(argv[i], \"--seed\") == 0 && i + 1 < argc) {\n"
+  "      seed = strtoull(argv[++i], NULL, 0);\n"
+  "    } else {\n"
+  "      fprintf(stderr, \"Usage: %s [-n COUNT] [--seed S]\\n\", argv[0]);\n"
+  "      return 1;\n"
+  "    }\n"
+  "  }\n"
+  "\n"
+  "  if (count <= 0) {\n"
+  "    generator = RandomGenerator(seed);\n"
+  "    for (int i = 1; i <= 3; i++) {\n"
+  "      size_t mark = out.size();\n"
+  "      out += \"Version #\" + to_string(i) + \": -------------\\n\";\n"
+  "      if (!generate()) {\n"
+  "        out.resize(mark);\n"
+  "        drain();\n"
+  "        printf(\"%s\\n\", error.c_str());\n"
+  "        return EXIT_FAILURE;\n"
+  "      }\n"
+  "      out += '\\n';\n"
+  "    }\n"
+  "  } else {\n"
+  "    // like rsg -n, write only whole chunks, so a failure loses the chunk it's in\n"
+  "    for (long i = 0; i < count; i++) {\n"
+  "      if (i % kSentencesPerChunk == 0) {\n"
+  "        drain();\n"
+  "        generator = RandomGenerator(seed, i / kSentencesPerChunk);\n"
+  "      }\n"
+  "      if (!generate()) {\n"
+  "        fprintf(stderr, \"%s\\n\", error.c_str());\n"
+  "        return EXIT_FAILURE;\n"
+  "      }\n"
+  "      out += '\\n';\n"
+  "    }\n"
+  "  }\n"
+  "\n"
+  "  drain();\n"
+  "  return 0;\n"
+  "}\n";
+
+/**
+ * Function: emitNonterminal
+ * -------------------------
+ * Writes the function expanding the specified nonterminal.  Every
+ * nonterminal consumes a draw from its alias table, even one with a
+ * single production, since Grammar::getRandomProduction does too.
+ * Each case is a single && chain, so the final call in a production
+ * is in tail position.  depth counts pending productions the way
+ * Generator's stack does: a production stops being pending once its
+ * last symbol is reached, so a call in tail position passes depth along
+ * unchanged, and right-recursive rules can run as deep as they do in rsg
+ * (a compiler optimizing sibling calls, as g++ -O2 does, turns those
+ * tail calls into jumps, so the C++ stack doesn't grow either).
+ */
+
+static void emitNonterminal(const Grammar& grammar, int nt, ostream& out)
+{
+  string name = quote(grammar.getNonterminal(nt));
+  out << "static bool expand" << nt << "(int depth)   // " << grammar.getNonterminal(nt) << endl;
+  out << "{" << endl;
+  int numProductions = grammar.getNumProductions(nt);
+  if (numProductions == 0) {
+    out << "  return undefined(" << name << ");" << endl << "}" << endl << endl;
+    return;
+  }
+
+  int first = grammar.getFirstProduction(nt);
+  out << "  static const uint32_t threshold[] = {";
+  for (int p = first; p < first + numProductions; p++)
+    out << (p == first ? " " : ", ") << grammar.getAliasThreshold(p) << "u";
+  out << " };" << endl;
+  out << "  static const int32_t alias[] = {";
+  for (int p = first; p < first + numProductions; p++)
+    out << (p == first ? " " : ", ") << grammar.getAlias(p);
+  out << " };" << endl;
+  out << "  if (depth >= kMaxDepth) return tooDeep(" << name << ");" << endl;
+  out << "  switch (sampleAliasTable(threshold, alias, " << numProductions << ", generator)) {" << endl;
+  for (int p = first; p < first + numProductions; p++) {
+    if (p + 1 == first + numProductions) out << "    default:";
+    else out << "    case " << p - first << ":";
+    const Grammar::symbol *begin = grammar.getProductionBegin(p);
+    const Grammar::symbol *end = grammar.getProductionEnd(p);
+    if (begin == end) out << " return true;";
+    for (const Grammar::symbol *s = begin; s != end; s++) {
+      out << (s == begin ? " return " : " && ");
+      if (Grammar::isNonterminal(*s))
+        out << "expand" << Grammar::getIndex(*s) << (s + 1 == end ? "(depth)" : "(depth + 1)");
+      else out << "emit(" << Grammar::getIndex(*s) << ")";
+    }
+    if (begin != end) out << ";";
+    out << endl;
+  }
+  out << "  }" << endl << "}" << endl << endl;
+}
+
+bool emitCpp(const Grammar& grammar, int start, const char *grammarFileName,
+             int maxDepth, long maxLength, ostream& out)
+{
+  out << "/**" << endl;
+  out << " * Generated by rsg --emit-cpp from " << grammarFileName << ".  Don't edit." << endl;
+  out << " * Build with" << endl;
+  out << " *" << endl;
+  out << " *     g++ -O2 -std=c++17 -I RSG -o program program.cc RSG/random.cc" << endl;
+  out << " *" << endl;
+  out << " * where RSG is the directory holding rsg's sources." << endl;
+  out << " */" << endl << endl;
+
+  out << "#include <string_view>" << endl;
+  out << "#include <stdint.h>" << endl << endl;
+  out << "static const int kMaxDepth = " << maxDepth << ";" << endl;
+  out << "static const long kMaxLength = " << maxLength << "L;" << endl;
+  out << "static const long kSentencesPerChunk = " << kSentencesPerChunk << ";" << endl << endl;
+  out << "static constexpr std::string_view kTerminals[] = {" << endl;
+  for (int t = 0; t < grammar.getNumTerminals(); t++) {
+    string_view terminal = grammar.getTerminal(t);
+    out << "  std::string_view(" << quote(terminal) << ", " << terminal.size() << ")," << endl;
+  }
+  if (grammar.getNumTerminals() == 0) out << "  std::string_view()" << endl;
+  out << "};" << endl << endl;
+
+  out << kPrologue;
+  for (int nt = 0; nt < grammar.getNumNonterminals(); nt++)
+    out << "static bool expand" << nt << "(int depth);" << endl;
+  out << endl;
+  for (int nt = 0; nt < grammar.getNumNonterminals(); nt++)
+    emitNonterminal(grammar, nt, out);
+  out << "static bool expandStart(int depth) { return expand" << start << "(depth); }" << endl;
+  out << kMain;
+  return out.good();
+}
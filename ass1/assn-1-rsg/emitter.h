@@ -0,0 +1,45 @@
+#ifndef __emitter__
+#define __emitter__
+
+/**
+ * File: emitter.h
+ * ---------------
+ * Defines the routine behind rsg --emit-cpp, which translates a
+ * compiled Grammar into a standalone C++ program that generates
+ * sentences from it with no interpretation at all.  Each nonterminal
+ * becomes a function that switches over its productions, the terminals
+ * become a constexpr table, and each nonterminal's alias table is
+ * baked in as a pair of constant arrays.
+ *
+ * The emitted program draws its random numbers exactly as rsg does,
+ * so for a given seed
+ *
+ *     ./program -n COUNT --seed S
+ *
+ * writes the same sentences as rsg -n COUNT --seed S (and if generation
+ * fails, the same whole chunks of them before failing), and without -n
+ * it writes the classic three versions.  It needs only random.h and
+ * alias.h to compile and random.cc to link:
+ *
+ *     g++ -O2 -std=c++17 -I RSG -o program program.cc RSG/random.cc
+ *
+ * where RSG is the directory holding rsg's sources.
+ */
+
+#include <ostream>
+#include "grammar.h"
+using namespace std;
+
+/**
+ * Function: emitCpp
+ * -----------------
+ * Writes the program generating sentences from the specified start
+ * nonterminal to out.  grammarFileName is only quoted in a comment, and
+ * maxDepth and maxLength become the program's caps on nesting depth and
+ * terminals per sentence.  Returns false if out reports an error.
+ */
+
+bool emitCpp(const Grammar& grammar, int start, const char *grammarFileName,
+             int maxDepth, long maxLength, ostream& out);
+
+#endif // ! __emitter__
@@ -0,0 +1,128 @@
+/**
+ * File: enumerator.cc
+ * -------------------
+ * Provides the implementation of the Enumerator class.
+ */
+
+#include "enumerator.h"
+
+static uint64_t saturatingAdd(uint64_t a, uint64_t b)
+{
+  return a > Enumerator::kSaturated - b ? Enumerator::kSaturated : a + b;
+}
+
+static uint64_t saturatingMultiply(uint64_t a, uint64_t b)
+{
+  if (a == 0 || b == 0) return 0;
+  return a > Enumerator::kSaturated / b ? Enumerator::kSaturated : a * b;
+}
+
+/**
+ * Constructor: Enumerator
+ * -----------------------
+ * Row 0 of the table is all zeroes, since no derivation has depth 0.
+ * Row d is computed from row d - 1: a nonterminal's count is the sum
+ * over its productions of the product of the counts of their symbols,
+ * where a terminal counts as exactly one way.
+ */
+
+Enumerator::Enumerator(const Grammar& grammar, int maxDepth) :
+  grammar(grammar), maxDepth(maxDepth), numNonterminals(grammar.getNumNonterminals()),
+  counts((maxDepth + 1) * (size_t) grammar.getNumNonterminals(), 0)
+{
+  for (int depth = 1; depth <= maxDepth; depth++) {
+    for (int nt = 0; nt < numNonterminals; nt++) {
+      uint64_t count = 0;
+      int first = grammar.getFirstProduction(nt);
+      for (int p = first; p < first + grammar.getNumProductions(nt); p++)
+        count = saturatingAdd(count, countProduction(p, depth - 1));
+      counts[depth * numNonterminals + nt] = count;
+    }
+  }
+}
+
+/**
+ * Method: countSymbol
+ * -------------------
+ * Returns the number of derivations of the specified symbol with
+ * depth at most depth.  A terminal derives itself, in one way.
+ */
+
+uint64_t Enumerator::countSymbol(Grammar::symbol s, int depth) const
+{
+  if (!Grammar::isNonterminal(s)) return 1;
+  return counts[depth * numNonterminals + Grammar::getIndex(s)];
+}
+
+/**
+ * Method: countProduction
+ * -----------------------
+ * Returns the number of ways the symbols of the specified production
+ * can each be derived within the specified depth.
+ */
+
+uint64_t Enumerator::countProduction(int production, int depth) const
+{
+  uint64_t count = 1;
+  const Grammar::symbol *end = grammar.getProductionEnd(production);
+  for (const Grammar::symbol *s = grammar.getProductionBegin(production); s != end && count != 0; s++)
+    count = saturatingMultiply(count, countSymbol(*s, depth));
+  return count;
+}
+
+/**
+ * Method: unrank
+ * --------------
+ * Works off an explicit stack of (symbol, depth, rank) tasks.  To
+ * expand a nonterminal, the rank is first used to select a production
+ * (each production owns a contiguous block of ranks, in order), and
+ * what remains is split across the production's symbols as the digits
+ * of a mixed-radix number whose radixes are the symbols' counts.  The
+ * symbol tasks are pushed in reverse, so they're expanded left to right.
+ * Because the starting count isn't saturated, no count consulted along
+ * the way is either.
+ */
+
+bool Enumerator::unrank(int nonterminal, uint64_t rank, OutputBuffer& out)
+{
+  uint64_t total = getCount(nonterminal);
+  if (total == kSaturated || rank >= total) return false;
+
+  stack.clear();
+  task root = { (nonterminal << 1) | 1, maxDepth, rank };
+  stack.push_back(root);
+  bool first = true;
+  while (!stack.empty()) {
+    task t = stack.back();
+    stack.pop_back();
+    if (!Grammar::isNonterminal(t.s)) {
+      if (!first) out.append(' ');
+      out.append(grammar.getTerminal(Grammar::getIndex(t.s)));
+      first = false;
+      continue;
+    }
+
+    int nt = Grammar::getIndex(t.s);
+    int p = grammar.getFirstProduction(nt);
+    while (true) {
+      uint64_t count = countProduction(p, t.depth - 1);
+      if (t.rank < count) break;
+      t.rank -= count;
+      p++;
+    }
+
+    size_t base = stack.size();
+    const Grammar::symbol *begin = grammar.getProductionBegin(p);
+    const Grammar::symbol *end = grammar.getProductionEnd(p);
+    stack.resize(base + (end - begin));
+    for (const Grammar::symbol *s = end; s != begin; ) {  // least significant digit is the last symbol
+      --s;
+      uint64_t radix = countSymbol(*s, t.depth - 1);
+      task child = { *s, t.depth - 1, t.rank % radix };
+      t.rank /= radix;
+      stack[base + (end - 1 - s)] = child;
+    }
+  }
+
+  return true;
+}
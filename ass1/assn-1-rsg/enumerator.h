@@ -0,0 +1,90 @@
+#ifndef __enumerator__
+#define __enumerator__
+
+/**
+ * File: enumerator.h
+ * ------------------
+ * Defines the Enumerator class, which counts the derivations of each
+ * nonterminal of a compiled Grammar up to a maximum derivation depth,
+ * and can produce the k-th of those derivations directly ("unranking").
+ * Every derivation of depth at most maxDepth gets a rank in [0, count),
+ * so a range of ranks is a well-defined shard of the sentence space:
+ * separate machines can enumerate disjoint ranges without coordinating,
+ * and a uniformly random rank is a uniformly random derivation.
+ *
+ * Counts are derivations, not distinct strings.  A grammar that can
+ * derive the same sentence in two ways (say, by listing a production
+ * twice) yields that sentence under two different ranks.
+ */
+
+#include <vector>
+#include <stdint.h>
+#include "grammar.h"
+#include "output.h"
+using namespace std;
+
+class Enumerator {
+
+ public:
+
+  /**
+   * Constant: kSaturated
+   * --------------------
+   * The count reported when the true count doesn't fit in 64 bits.
+   * Counting saturates rather than wrapping, so a saturated count
+   * is a lower bound.
+   */
+
+  static const uint64_t kSaturated = UINT64_MAX;
+
+  /**
+   * Constructor: Enumerator
+   * -----------------------
+   * Counts, for every nonterminal of the specified Grammar, the number
+   * of derivations whose tree is at most maxDepth nonterminals deep.
+   * The counts are memoized bottom up, one depth at a time, so this
+   * takes time proportional to maxDepth times the size of the grammar.
+   */
+
+  Enumerator(const Grammar& grammar, int maxDepth);
+
+  /**
+   * Method: getCount
+   * ----------------
+   * Returns the number of derivations of the specified nonterminal
+   * with depth at most maxDepth, or kSaturated.
+   */
+
+  uint64_t getCount(int nonterminal) const { return counts[maxDepth * numNonterminals + nonterminal]; }
+
+  /**
+   * Method: unrank
+   * --------------
+   * Appends the sentence produced by the derivation of the specified
+   * nonterminal with the specified rank to out, with terminals separated
+   * by single spaces.  Derivations are ranked in order of production
+   * choice, earliest symbols most significant.  Returns false (and appends
+   * nothing) if the rank isn't less than getCount(nonterminal), or if the
+   * count is saturated and ranks are therefore meaningless.
+   */
+
+  bool unrank(int nonterminal, uint64_t rank, OutputBuffer& out);
+
+ private:
+  struct task {
+    Grammar::symbol s;
+    int depth;        // depth budget remaining for s
+    uint64_t rank;    // rank of the derivation of s to produce
+  };
+
+  const Grammar& grammar;
+  int maxDepth;
+  int numNonterminals;
+  vector<uint64_t> counts;    // counts[d * numNonterminals + nt]: derivations of nt of depth <= d
+  vector<task> stack;
+
+  uint64_t countSymbol(Grammar::symbol s, int depth) const;
+  uint64_t countProduction(int production, int depth) const;
+};
+
+#endif // ! __enumerator__
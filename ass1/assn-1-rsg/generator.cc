@@ -0,0 +1,122 @@
+/**
+ * File: generator.cc
+ * ------------------
+ * Provides the implementation of the Generator class, which
+ * is an iterative, explicit-stack replacement for the original
+ * recursive getExtensions function.
+ */
+
+#include "generator.h"
+#include <sstream>
+
+Generator::Generator(const Grammar& grammar, int maxDepth, long maxLength) :
+  grammar(grammar), maxDepth(maxDepth), maxLength(maxLength), length(0) {}
+
+/**
+ * Method: push
+ * ------------
+ * Chooses one of the specified nonterminal's productions and pushes
+ * a cursor addressing its first symbol.  Returns false (after setting
+ * the error message) if the nonterminal is undefined or if the stack
+ * is already as deep as it's allowed to be.
+ */
+
+bool Generator::push(int nonterminal)
+{
+  if (grammar.getNumProductions(nonterminal) == 0) {
+    error = "Could not find \"" + string(grammar.getNonterminal(nonterminal)) + "\" in the grammar file.";
+    return false;
+  }
+
+  if ((int) stack.size() >= maxDepth) {
+    ostringstream message;
+    message << "Expansion exceeded the maximum depth of " << maxDepth
+            << " pending productions while expanding \"" << grammar.getNonterminal(nonterminal) << "\".";
+    error = message.str();
+    return false;
+  }
+
+  int production = grammar.getRandomProduction(nonterminal, random);
+  cursor top = { grammar.getProductionBegin(production), grammar.getProductionEnd(production) };
+  stack.push_back(top);
+  return true;
+}
+
+bool Generator::start(int nonterminal)
+{
+  stack.clear();
+  error.clear();
+  length = 0;
+  return push(nonterminal);
+}
+
+/**
+ * Method: next
+ * ------------
+ * Repeatedly advances the cursor on top of the stack until it reaches a
+ * terminal, which is handed back without being copied anywhere.  Nonterminals
+ * push a new cursor.  When a nonterminal is the last symbol of its production,
+ * the exhausted cursor is popped before the new one is pushed, so that
+ * right-recursive rules (the common case: "<list> ... , <list>") run in
+ * constant stack space.  On failure the stack is emptied, so that further
+ * calls keep returning false.
+ */
+
+bool Generator::next(string_view& terminal)
+{
+  while (!stack.empty()) {
+    cursor& top = stack.back();
+    if (top.curr == top.end) {
+      stack.pop_back();
+      continue;
+    }
+
+    Grammar::symbol s = *top.curr++;
+    if (Grammar::isNonterminal(s)) {
+      if (top.curr == top.end) stack.pop_back();  // tail position: nothing left to come back to
+      if (!push(Grammar::getIndex(s))) {
+        stack.clear();
+        return false;
+      }
+    } else {
+      if (++length > maxLength) {
+        ostringstream message;
+        message << "Expansion exceeded the maximum length of " << maxLength << " terminals.";
+        error = message.str();
+        stack.clear();
+        return false;
+      }
+      terminal = grammar.getTerminal(Grammar::getIndex(s));
+      return true;
+    }
+  }
+
+  return false;
+}
+
+/**
+ * Method: generate
+ * ----------------
+ * Drains next into the output buffer, separating terminals
+ * with spaces, and backs the sentence out if it fails.
+ */
+
+bool Generator::generate(int nonterminal, OutputBuffer& out)
+{
+  size_t mark = out.size();
+  string_view terminal;
+  if (start(nonterminal)) {
+    bool first = true;
+    while (next(terminal)) {
+      if (!first) out.append(' ');
+      out.append(terminal);
+      first = false;
+    }
+  }
+
+  if (failed()) {
+    out.truncate(mark);
+    return false;
+  }
+  return true;
+}
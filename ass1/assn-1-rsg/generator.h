@@ -0,0 +1,134 @@
+#ifndef __generator__
+#define __generator__
+
+/**
+ * File: generator.h
+ * -----------------
+ * Defines the Generator class, which expands a nonterminal of
+ * a compiled Grammar into a random sentence.  Rather than recursing
+ * once per nonterminal, the Generator maintains an explicit stack of
+ * cursors, each of which points into a production stored in place
+ * inside the Grammar.  Deeply recursive grammars therefore can't
+ * overflow the C++ call stack, and no Production is ever copied.
+ */
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include "grammar.h"
+#include "random.h"
+#include "output.h"
+using namespace std;
+
+class Generator {
+
+ public:
+
+  /**
+   * Constants: kDefaultMaxDepth, kDefaultMaxLength
+   * ----------------------------------------------
+   * The default caps on the number of partially expanded
+   * productions that may be pending at once, and on the number
+   * of terminals a single sentence may contain.
+   */
+
+  static const int kDefaultMaxDepth = 100000;
+  static const long kDefaultMaxLength = 10000000;
+
+  /**
+   * Constructor: Generator
+   * ----------------------
+   * Constructs a Generator layered over the specified Grammar, which
+   * must outlive the Generator.  Each Generator owns its own stack, so
+   * it can be reused from one sentence to the next without reallocating.
+   *
+   * @param grammar the compiled grammar to expand.
+   * @param maxDepth the maximum number of productions that may be
+   *                 simultaneously pending expansion.
+   * @param maxLength the maximum number of terminals in one sentence.
+   */
+
+  Generator(const Grammar& grammar, int maxDepth = kDefaultMaxDepth,
+            long maxLength = kDefaultMaxLength);
+
+  /**
+   * Method: generate
+   * ----------------
+   * Expands the specified nonterminal into a random sentence, appending
+   * its terminals (separated by single spaces) to the end of out.  No
+   * newline is written.  If the expansion reaches an undefined nonterminal
+   * or exceeds either of the caps, generation stops, false is returned,
+   * and getError describes what went wrong.  Whatever was produced up to
+   * that point is backed out of out again, unless out has already
+   * drained it to its file descriptor.
+   *
+   * @param nonterminal the id of the nonterminal to expand.
+   * @param out the buffer to which terminals are appended.
+   * @return true if and only if the expansion completed.
+   */
+
+  bool generate(int nonterminal, OutputBuffer& out);
+
+  /**
+   * Methods: start, next, failed
+   * ----------------------------
+   * The pull-based form of generate, for clients that want terminals
+   * one at a time rather than a finished sentence.  start begins a new
+   * expansion of the specified nonterminal (abandoning any expansion in
+   * progress), and each call to next sets terminal to the following
+   * terminal and returns true, or returns false once the sentence is
+   * over.  Memory use is bounded by maxDepth no matter how long the
+   * sentence is, so arbitrarily large documents can be streamed.
+   *
+   * next also returns false if the expansion fails, in which case failed
+   * returns true and getError explains why.  Each string_view addresses
+   * the Grammar's terminal pool, and so remains valid as long as the
+   * Grammar does.
+   *
+   *    generator.start(nonterminal);
+   *    string_view terminal;
+   *    while (generator.next(terminal)) consume(terminal);
+   *    if (generator.failed()) ...
+   */
+
+  bool start(int nonterminal);
+  bool next(string_view& terminal);
+  bool failed() const { return !error.empty(); }
+
+  /**
+   * Method: getError
+   * ----------------
+   * Returns a human-readable description of why the most recent
+   * call to generate failed.
+   */
+
+  const string& getError() const { return error; }
+
+  /**
+   * Method: seed
+   * ------------
+   * Restarts the Generator's private random sequence from the specified
+   * seed and stream number.  Generators that are never seeded draw on
+   * the current time.
+   */
+
+  void seed(uint64_t seed, uint64_t stream = 0) { random = RandomGenerator(seed, stream); }
+
+ private:
+  struct cursor {
+    const Grammar::symbol *curr;
+    const Grammar::symbol *end;
+  };
+
+  const Grammar& grammar;
+  int maxDepth;
+  long maxLength;
+  RandomGenerator random;
+  vector<cursor> stack;
+  long length;          // terminals produced so far by the current expansion
+  string error;
+
+  bool push(int nonterminal);
+};
+
+#endif // ! __generator__
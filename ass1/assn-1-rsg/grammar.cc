@@ -0,0 +1,573 @@
+/**
+ * File: grammar.cc
+ * ----------------
+ * Provides the implementation of the Grammar class, which
+ * compiles a map<string, Definition> down to flat arrays
+ * of interned symbol ids.
+ */
+
+#include "grammar.h"
+#include "alias.h"
+#include <algorithm>
+#include <unordered_map>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static bool isNonterminalText(string_view token)
+{
+  return token.size() >= 2 && token[0] == '<' && token[token.size() - 1] == '>';
+}
+
+/**
+ * Helper: intern
+ * --------------
+ * Returns the id associated with the specified string in the
+ * specified table, appending the string to the list of names
+ * (and minting a fresh id) if this is the first time it's been seen.
+ */
+
+static int intern(const string& name, map<string, int>& ids, vector<string>& names)
+{
+  map<string, int>::iterator found = ids.find(name);
+  if (found != ids.end()) return found->second;
+  int id = names.size();
+  ids[name] = id;
+  names.push_back(name);
+  return id;
+}
+
+/**
+ * Struct: imageHeader
+ * -------------------
+ * Leads off every grammar image.  The arrays follow in this order,
+ * each padded out to a multiple of four bytes:
+ *
+ *     double  weights[numProductions]
+ *     int32_t definitionStart[numNonterminals + 1]
+ *     int32_t productionStart[numProductions + 1]
+ *     int32_t symbols[numSymbols]
+ *     uint32_t aliasThreshold[numProductions]
+ *     int32_t alias[numProductions]
+ *     int32_t nonterminalStart[numNonterminals + 1]
+ *     int32_t terminalStart[numTerminals + 1]
+ *     char    nonterminalPool[nonterminalPoolSize]
+ *     char    terminalPool[terminalPoolSize]
+ *
+ * Everything is stored in native byte order; byteOrder lets a
+ * loader on the other kind of machine notice and refuse the file.
+ * The weights are kept at full precision, since the tiny weights
+ * --budget produces would otherwise round to zero, and they come first
+ * (the header being a multiple of eight bytes long) to keep them aligned.
+ */
+
+struct imageHeader {
+  char magic[4];
+  uint32_t byteOrder;
+  uint32_t version;
+  int32_t numNonterminals;
+  int32_t numTerminals;
+  int32_t numProductions;
+  int32_t numSymbols;
+  int32_t nonterminalPoolSize;
+  int32_t terminalPoolSize;
+  uint32_t reserved;          // always 0; pads the header to eight-byte alignment
+};
+
+static_assert(sizeof(imageHeader) % sizeof(double) == 0, "the weights must start aligned");
+
+static const char kImageMagic[4] = { 'R', 'S', 'G', 'C' };
+static const uint32_t kImageByteOrder = 0x01020304;
+static const uint32_t kImageVersion = 4;
+
+static size_t padded(size_t numBytes)
+{
+  return (numBytes + 3) & ~(size_t) 3;
+}
+
+/**
+ * Helper: appendArray
+ * -------------------
+ * Copies the specified bytes to the end of the image, followed
+ * by enough zeroes to restore four-byte alignment.
+ */
+
+static void appendArray(vector<char>& image, const void *data, size_t numBytes)
+{
+  const char *bytes = (const char *) data;
+  image.insert(image.end(), bytes, bytes + numBytes);
+  image.resize(padded(image.size()), '\0');
+}
+
+/**
+ * Helper: appendPool
+ * ------------------
+ * Appends the offset table and the concatenated text of the specified
+ * strings, returning the pool (which is appended later, after all of
+ * the offset tables, so that the int32_t arrays stay together).
+ */
+
+static string appendPool(vector<char>& image, const vector<string>& strings)
+{
+  string pool;
+  vector<int32_t> start;
+  for (int i = 0; i < (int) strings.size(); i++) {
+    start.push_back(pool.size());
+    pool += strings[i];
+  }
+  start.push_back(pool.size());
+  appendArray(image, start.data(), start.size() * sizeof(int32_t));
+  return pool;
+}
+
+Grammar::Grammar() : mapping(NULL), mappingSize(0)
+{
+  tables compiled;
+  compiled.definitionStart.push_back(0);
+  compiled.productionStart.push_back(0);
+  pack(compiled);
+}
+
+/**
+ * Constructor: Grammar
+ * --------------------
+ * Makes two passes over the definitions.  The first assigns every
+ * defined nonterminal its id, so that the defined nonterminals occupy
+ * ids 0 through definitions.size() - 1.  The second flattens the
+ * productions, interning terminals and any undefined nonterminals as
+ * they're discovered.  Undefined nonterminals are given empty
+ * definitions once all of the real ones have been laid down, and
+ * then the whole thing is packed into an image.
+ */
+
+Grammar::Grammar(const map<string, Definition>& definitions) : mapping(NULL), mappingSize(0)
+{
+  tables compiled;
+  map<string, int> nonterminalIds, terminalIds;
+  for (map<string, Definition>::const_iterator curr = definitions.begin();
+       curr != definitions.end(); ++curr)
+    intern(curr->first, nonterminalIds, compiled.nonterminals);
+
+  for (map<string, Definition>::const_iterator curr = definitions.begin();
+       curr != definitions.end(); ++curr) {
+    compiled.definitionStart.push_back(compiled.productionStart.size());
+    const Definition& def = curr->second;
+    for (Definition::const_iterator prod = def.begin(); prod != def.end(); ++prod) {
+      compiled.productionStart.push_back(compiled.symbols.size());
+      for (Production::const_iterator token = prod->begin(); token != prod->end(); ++token) {
+        if (isNonterminalText(*token)) {
+          compiled.symbols.push_back((intern(*token, nonterminalIds, compiled.nonterminals) << 1) | 1);
+        } else {
+          compiled.symbols.push_back(intern(*token, terminalIds, compiled.terminals) << 1);
+        }
+      }
+      compiled.weights.push_back(prod->getWeight());
+    }
+  }
+
+  while (compiled.definitionStart.size() <= compiled.nonterminals.size())
+    compiled.definitionStart.push_back(compiled.productionStart.size());  // undefined ones, plus the sentinel
+  compiled.productionStart.push_back(compiled.symbols.size());
+  pack(compiled);
+}
+
+/**
+ * Helpers: isSpace, skipSpace, skipToken, skipLine
+ * ------------------------------------------------
+ * The scanning primitives of the parsing constructor.  isSpace matches
+ * isspace in the "C" locale (which is what operator>> uses by default)
+ * with a table lookup, and skipLine leans on memchr, which libc
+ * vectorizes, to find the end of the line.
+ */
+
+static const struct spaceTable {
+  bool space[256];
+  spaceTable() : space() { for (const char *ch = " \t\n\v\f\r"; *ch != '\0'; ch++) space[(unsigned char) *ch] = true; }
+} kSpaces;
+
+static inline bool isSpace(char ch) { return kSpaces.space[(unsigned char) ch]; }
+
+static const char *skipSpace(const char *curr, const char *end)
+{
+  while (curr < end && isSpace(*curr)) curr++;
+  return curr;
+}
+
+static const char *skipToken(const char *curr, const char *end)
+{
+  while (curr < end && !isSpace(*curr)) curr++;
+  return curr;
+}
+
+static const char *skipLine(const char *curr, const char *end)
+{
+  const char *newline = (const char *) memchr(curr, '\n', end - curr);
+  return newline == NULL ? end : newline + 1;
+}
+
+/**
+ * Helper: intern
+ * --------------
+ * The string_view flavor of intern, used by the parsing constructor.
+ * Keys address the text being parsed, so only the first occurrence
+ * of each distinct name is ever copied.
+ */
+
+static int intern(string_view name, unordered_map<string_view, int>& ids, vector<string>& names)
+{
+  pair<unordered_map<string_view, int>::iterator, bool> found = ids.insert(make_pair(name, (int) names.size()));
+  if (found.second) names.push_back(string(name));
+  return found.first->second;
+}
+
+/**
+ * Constructor: Grammar
+ * --------------------
+ * Scans the text once, recording every definition and production as
+ * a run of tokens that point back into the text.  The definitions are
+ * then put into the order a map<string, Definition> would hold them
+ * in (sorted by name, with later definitions of the same nonterminal
+ * replacing earlier ones) and compiled just as the compiling constructor
+ * does, so that ids, and therefore images and generated sentences, are
+ * exactly the same either way.
+ *
+ * The scan mirrors the stream-based reader: skip to the next '{', take
+ * the next token as the nonterminal and ignore the rest of its line,
+ * then read productions (tokens up to a lone ";", ignoring the rest of
+ * the line) until a line starts with '}'.  Text that runs out in the
+ * middle of a definition just ends the grammar.
+ */
+
+struct parsedProduction {
+  int firstToken;
+  int numTokens;
+  double weight;
+};
+
+struct parsedDefinition {
+  string_view nonterminal;
+  int firstProduction;
+  int numProductions;
+};
+
+Grammar::Grammar(const char *text, size_t length) : mapping(NULL), mappingSize(0)
+{
+  vector<string_view> tokens;
+  vector<parsedProduction> productions;
+  vector<parsedDefinition> definitions;
+
+  const char *curr = text, *end = text + length;
+  while (true) {
+    const char *open = (const char *) memchr(curr, '{', end - curr);
+    if (open == NULL) break;
+    curr = skipSpace(open + 1, end);
+    const char *tokenEnd = skipToken(curr, end);
+    parsedDefinition def = { string_view(curr, tokenEnd - curr), (int) productions.size(), 0 };
+    curr = skipLine(tokenEnd, end);
+
+    bool complete = false;
+    while (curr < end) {
+      if (*curr == '}') {
+        curr++;
+        complete = true;
+        break;
+      }
+
+      parsedProduction prod = { (int) tokens.size(), 0, 1.0 };
+      bool terminated = false;
+      while (true) {
+        curr = skipSpace(curr, end);
+        if (curr == end) break;
+        tokenEnd = skipToken(curr, end);
+        string_view token(curr, tokenEnd - curr);
+        curr = tokenEnd;
+        if (token == ";") {
+          terminated = true;
+          break;
+        }
+        if (!(tokens.size() == (size_t) prod.firstToken && token[0] == '[' &&
+              Production::parseWeight(string(token), prod.weight)))
+          tokens.push_back(token);
+      }
+      if (!terminated) break;
+      prod.numTokens = tokens.size() - prod.firstToken;
+      productions.push_back(prod);
+      def.numProductions++;
+      curr = skipLine(curr, end);
+    }
+
+    if (!complete) break;
+    definitions.push_back(def);
+  }
+
+  // a stable sort keeps repeated definitions in file order, so the last one wins
+  vector<int> order(definitions.size());
+  for (int i = 0; i < (int) order.size(); i++) order[i] = i;
+  stable_sort(order.begin(), order.end(), [&definitions](int a, int b) {
+    return definitions[a].nonterminal < definitions[b].nonterminal;
+  });
+  vector<int> chosen;
+  for (int i = 0; i < (int) order.size(); i++) {
+    if (i + 1 < (int) order.size() && definitions[order[i]].nonterminal == definitions[order[i + 1]].nonterminal) continue;
+    chosen.push_back(order[i]);
+  }
+
+  tables compiled;
+  unordered_map<string_view, int> nonterminalIds, terminalIds;
+  nonterminalIds.reserve(2 * chosen.size());
+  for (int i = 0; i < (int) chosen.size(); i++)
+    intern(definitions[chosen[i]].nonterminal, nonterminalIds, compiled.nonterminals);
+
+  compiled.productionStart.reserve(productions.size() + 1);
+  compiled.symbols.reserve(tokens.size());
+  compiled.weights.reserve(productions.size());
+  for (int i = 0; i < (int) chosen.size(); i++) {
+    const parsedDefinition& def = definitions[chosen[i]];
+    compiled.definitionStart.push_back(compiled.productionStart.size());
+    for (int p = def.firstProduction; p < def.firstProduction + def.numProductions; p++) {
+      const parsedProduction& prod = productions[p];
+      compiled.productionStart.push_back(compiled.symbols.size());
+      for (int t = prod.firstToken; t < prod.firstToken + prod.numTokens; t++) {
+        if (isNonterminalText(tokens[t])) {
+          compiled.symbols.push_back((intern(tokens[t], nonterminalIds, compiled.nonterminals) << 1) | 1);
+        } else {
+          compiled.symbols.push_back(intern(tokens[t], terminalIds, compiled.terminals) << 1);
+        }
+      }
+      compiled.weights.push_back(prod.weight);
+    }
+  }
+
+  while (compiled.definitionStart.size() <= compiled.nonterminals.size())
+    compiled.definitionStart.push_back(compiled.productionStart.size());  // undefined ones, plus the sentinel
+  compiled.productionStart.push_back(compiled.symbols.size());
+  pack(compiled);
+}
+
+/**
+ * Constructor: Grammar
+ * --------------------
+ * Maps the image file read-only and attaches to the mapping.  On
+ * any failure the Grammar is left with base set to NULL, which
+ * is what good() checks for.
+ */
+
+Grammar::Grammar(const string& imageFileName) : mapping(NULL), mappingSize(0), base(NULL), size(0)
+{
+  int fd = open(imageFileName.c_str(), O_RDONLY);
+  if (fd == -1) return;
+  struct stat stats;
+  if (fstat(fd, &stats) == 0 && stats.st_size > 0) {
+    mappingSize = stats.st_size;
+    mapping = mmap(NULL, mappingSize, PROT_READ, MAP_SHARED, fd, 0);
+    if (mapping == MAP_FAILED) mapping = NULL;
+  }
+  close(fd);  // the mapping outlives the descriptor
+
+  if (mapping != NULL && !attach((const char *) mapping, mappingSize)) base = NULL;
+}
+
+Grammar::~Grammar()
+{
+  if (mapping != NULL) munmap(mapping, mappingSize);
+}
+
+/**
+ * Helper: fillAliasTables
+ * -----------------------
+ * Builds one alias table per nonterminal from the weights of its
+ * productions, writing them side by side into threshold and alias.
+ */
+
+static void fillAliasTables(const int32_t *definitionStart, int numNonterminals,
+                            const double *weights, uint32_t *threshold, int32_t *alias)
+{
+  for (int nt = 0; nt < numNonterminals; nt++) {
+    int first = definitionStart[nt], last = definitionStart[nt + 1];
+    vector<double> definitionWeights(weights + first, weights + last);
+    vector<uint32_t> definitionThreshold;
+    vector<int32_t> definitionAlias;
+    buildAliasTable(definitionWeights, definitionThreshold, definitionAlias);
+    copy(definitionThreshold.begin(), definitionThreshold.end(), threshold + first);
+    copy(definitionAlias.begin(), definitionAlias.end(), alias + first);
+  }
+}
+
+/**
+ * Reweighting Constructor: Grammar
+ * --------------------------------
+ * Copies the original's image into the receiver's own storage and
+ * then overwrites the weights and alias tables in place.  Everything
+ * else, including all of the ids, is shared with the original.
+ */
+
+Grammar::Grammar(const Grammar& original, const vector<double>& newWeights) :
+  image(original.base, original.base + original.size), mapping(NULL), mappingSize(0)
+{
+  attach(image.data(), image.size());
+  double *writableWeights = (double *) (image.data() + ((const char *) weights - base));
+  for (int p = 0; p < numProductions; p++)
+    writableWeights[p] = newWeights[p];
+  fillAliasTables(definitionStart, numNonterminals, weights,
+                  (uint32_t *) (image.data() + ((const char *) aliasThreshold - base)),
+                  (int32_t *) (image.data() + ((const char *) alias - base)));
+}
+
+/**
+ * Method: pack
+ * ------------
+ * Lays the specified tables out as an image in the receiver's own
+ * storage and attaches to it.
+ */
+
+void Grammar::pack(const tables& compiled)
+{
+  vector<char> packed(sizeof(imageHeader));
+  const vector<double>& weights = compiled.weights;
+  appendArray(packed, weights.data(), weights.size() * sizeof(double));
+  appendArray(packed, compiled.definitionStart.data(), compiled.definitionStart.size() * sizeof(int32_t));
+  appendArray(packed, compiled.productionStart.data(), compiled.productionStart.size() * sizeof(int32_t));
+  appendArray(packed, compiled.symbols.data(), compiled.symbols.size() * sizeof(symbol));
+
+  size_t aliasTables = packed.size();
+  packed.resize(packed.size() + weights.size() * (sizeof(uint32_t) + sizeof(int32_t)));
+  fillAliasTables(compiled.definitionStart.data(), compiled.nonterminals.size(), weights.data(),
+                  (uint32_t *) (packed.data() + aliasTables),
+                  (int32_t *) (packed.data() + aliasTables + weights.size() * sizeof(uint32_t)));
+  string nonterminalText = appendPool(packed, compiled.nonterminals);
+  string terminalText = appendPool(packed, compiled.terminals);
+  appendArray(packed, nonterminalText.data(), nonterminalText.size());
+  appendArray(packed, terminalText.data(), terminalText.size());
+
+  imageHeader header;
+  memcpy(header.magic, kImageMagic, sizeof(header.magic));
+  header.byteOrder = kImageByteOrder;
+  header.version = kImageVersion;
+  header.numNonterminals = compiled.nonterminals.size();
+  header.numTerminals = compiled.terminals.size();
+  header.numProductions = compiled.productionStart.size() - 1;
+  header.numSymbols = compiled.symbols.size();
+  header.nonterminalPoolSize = nonterminalText.size();
+  header.terminalPoolSize = terminalText.size();
+  header.reserved = 0;
+  memcpy(packed.data(), &header, sizeof(header));
+
+  image.swap(packed);
+  attach(image.data(), image.size());
+}
+
+/**
+ * Method: attach
+ * --------------
+ * Points the table pointers into the specified image, after
+ * confirming that the header is one we understand and that the
+ * arrays it describes fit exactly within the image.  The contents of
+ * the arrays themselves are trusted, since checking them would mean
+ * touching every page of the image.
+ */
+
+bool Grammar::attach(const char *data, size_t length)
+{
+  base = NULL;
+  if (length < sizeof(imageHeader)) return false;
+  imageHeader header;
+  memcpy(&header, data, sizeof(header));
+  if (memcmp(header.magic, kImageMagic, sizeof(header.magic)) != 0 ||
+      header.byteOrder != kImageByteOrder || header.version != kImageVersion) return false;
+  if (header.numNonterminals < 0 || header.numTerminals < 0 || header.numProductions < 0 ||
+      header.numSymbols < 0 || header.nonterminalPoolSize < 0 || header.terminalPoolSize < 0) return false;
+
+  size_t offset = sizeof(imageHeader);
+  size_t weightOffset = offset;
+  offset += header.numProductions * sizeof(double);
+  size_t definitionOffset = offset;
+  offset += (header.numNonterminals + 1) * sizeof(int32_t);
+  size_t productionOffset = offset;
+  offset += (header.numProductions + 1) * sizeof(int32_t);
+  size_t symbolOffset = offset;
+  offset += header.numSymbols * sizeof(symbol);
+  size_t thresholdOffset = offset;
+  offset += header.numProductions * sizeof(uint32_t);
+  size_t aliasOffset = offset;
+  offset += header.numProductions * sizeof(int32_t);
+  size_t nonterminalStartOffset = offset;
+  offset += (header.numNonterminals + 1) * sizeof(int32_t);
+  size_t terminalStartOffset = offset;
+  offset += (header.numTerminals + 1) * sizeof(int32_t);
+  size_t nonterminalPoolOffset = offset;
+  offset += padded(header.nonterminalPoolSize);
+  size_t terminalPoolOffset = offset;
+  offset += padded(header.terminalPoolSize);
+  if (offset != length) return false;
+
+  numNonterminals = header.numNonterminals;
+  numTerminals = header.numTerminals;
+  numProductions = header.numProductions;
+  definitionStart = (const int32_t *) (data + definitionOffset);
+  productionStart = (const int32_t *) (data + productionOffset);
+  symbols = (const symbol *) (data + symbolOffset);
+  weights = (const double *) (data + weightOffset);
+  aliasThreshold = (const uint32_t *) (data + thresholdOffset);
+  alias = (const int32_t *) (data + aliasOffset);
+  nonterminalStart = (const int32_t *) (data + nonterminalStartOffset);
+  terminalStart = (const int32_t *) (data + terminalStartOffset);
+  nonterminalPool = data + nonterminalPoolOffset;
+  terminalPool = data + terminalPoolOffset;
+  if (definitionStart[numNonterminals] != numProductions ||
+      productionStart[numProductions] != header.numSymbols ||
+      nonterminalStart[numNonterminals] != header.nonterminalPoolSize ||
+      terminalStart[numTerminals] != header.terminalPoolSize) return false;
+
+  base = data;
+  size = length;
+  return true;
+}
+
+bool Grammar::save(const string& imageFileName) const
+{
+  // the image is written off to the side and renamed into place, so that
+  // anyone with the old image mapped (the --serve daemon, say) keeps
+  // seeing the old bytes rather than a half-written file
+  string tempFileName = imageFileName + ".tmp";
+  FILE *outfile = fopen(tempFileName.c_str(), "wb");
+  if (outfile == NULL) return false;
+  bool succeeded = fwrite(base, 1, size, outfile) == size;
+  succeeded = fclose(outfile) == 0 && succeeded;
+  if (succeeded && rename(tempFileName.c_str(), imageFileName.c_str()) == 0) return true;
+  remove(tempFileName.c_str());
+  return false;
+}
+
+bool Grammar::isImageFile(const string& fileName)
+{
+  char magic[sizeof(kImageMagic)];
+  FILE *infile = fopen(fileName.c_str(), "rb");
+  if (infile == NULL) return false;
+  bool isImage = fread(magic, 1, sizeof(magic), infile) == sizeof(magic) &&
+                 memcmp(magic, kImageMagic, sizeof(magic)) == 0;
+  fclose(infile);
+  return isImage;
+}
+
+int Grammar::lookupNonterminal(string_view name) const
+{
+  for (int nt = 0; nt < numNonterminals; nt++)
+    if (getNonterminal(nt) == name) return nt;
+  return -1;
+}
+
+/**
+ * Method: getRandomProduction
+ * ---------------------------
+ * Mirrors Definition::getRandomProduction, save for the fact
+ * that it returns a production id instead of a reference.
+ */
+
+int Grammar::getRandomProduction(int nt, RandomGenerator& random) const
+{
+  int first = definitionStart[nt];
+  return first + sampleAliasTable(aliasThreshold + first, alias + first, getNumProductions(nt), random);
+}
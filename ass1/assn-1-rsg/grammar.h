@@ -0,0 +1,265 @@
+#ifndef __grammar__
+#define __grammar__
+
+/**
+ * File: grammar.h
+ * ---------------
+ * Defines the Grammar class, which is the compiled form of
+ * the map<string, Definition> built up by readGrammar.  Every
+ * nonterminal and every terminal is interned into a dense integer
+ * id, and every Production is flattened into a run of tagged
+ * symbols stored back to back in one big array.  Expanding a
+ * nonterminal is then nothing more than array indexing: no string
+ * compares, no map lookups, and no '<' / '>' checks per token.
+ * The terminals themselves are packed end to end into a single
+ * pool, and getTerminal hands out string_views into it, so the
+ * output path can copy them directly into an OutputBuffer.
+ *
+ * All of the tables live in one contiguous, position-independent
+ * image, which can be saved to disk (rsg --compile) and later mapped
+ * back in read-only, so short-lived jobs skip parsing entirely.
+ */
+
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <stdint.h>
+#include "definition.h"
+#include "random.h"
+using namespace std;
+
+class Grammar {
+
+ public:
+
+  /**
+   * Type: symbol
+   * ------------
+   * A tagged symbol id as stored in a compiled production.  The
+   * low bit distinguishes nonterminals (1) from terminals (0), and
+   * the remaining bits hold the index into the corresponding table.
+   */
+
+  typedef int symbol;
+
+  /**
+   * Default Constructor: Grammar
+   * ----------------------------
+   * Constructs an empty Grammar with no nonterminals
+   * and no terminals.
+   */
+
+  Grammar();
+
+  /**
+   * Compiling Constructor: Grammar
+   * ------------------------------
+   * Interns every nonterminal and terminal appearing in the specified
+   * collection of Definitions and flattens each Production into the
+   * compiled representation.  Nonterminals that are referenced by some
+   * production but never defined are still assigned an id; they simply
+   * have no productions, which getNumProductions reports as 0.
+   *
+   * @param definitions the map built up by readGrammar, keyed by nonterminal.
+   */
+
+  Grammar(const map<string, Definition>& definitions);
+
+  /**
+   * Parsing Constructor: Grammar
+   * ----------------------------
+   * Parses the text of a grammar file (typically mapped straight out
+   * of the file) and compiles it, without building any Definitions or
+   * Productions along the way.  The text is read exactly as readGrammar
+   * and the Definition and Production constructors read it, and the
+   * resulting Grammar is identical to the one the compiling constructor
+   * would build from their map.  The text needn't be null-terminated,
+   * and needn't outlive the constructor.
+   *
+   * @param text the contents of a grammar file.
+   * @param length the number of bytes in text.
+   */
+
+  Grammar(const char *text, size_t length);
+
+  /**
+   * Reweighting Constructor: Grammar
+   * --------------------------------
+   * Constructs a copy of the original Grammar in which production p
+   * carries weight weights[p] instead of its original weight.  The ids
+   * of all symbols and productions are unchanged.
+   *
+   * @param original the Grammar being copied.
+   * @param weights the new weight of every production, indexed by production id.
+   */
+
+  Grammar(const Grammar& original, const vector<double>& weights);
+
+  /**
+   * Loading Constructor: Grammar
+   * ----------------------------
+   * Maps the precompiled grammar image stored in the specified file
+   * (as written by save) and generates directly out of the mapping.
+   * Nothing is parsed or copied, so this is about as fast as opening
+   * the file.  Check good() before using the Grammar.
+   *
+   * @param imageFileName the name of a file written by Grammar::save.
+   */
+
+  Grammar(const string& imageFileName);
+
+  /**
+   * Destructor: ~Grammar
+   * --------------------
+   * Unmaps the image file, if there is one.
+   */
+
+  ~Grammar();
+
+  /**
+   * Predicate Method: good
+   * ----------------------
+   * Returns true unless the Grammar was loaded from an image file
+   * that couldn't be opened, or that isn't a well-formed image
+   * written by this version of rsg on a machine of the same byte order.
+   */
+
+  bool good() const { return base != NULL; }
+
+  /**
+   * Method: save
+   * ------------
+   * Writes the compiled image to the specified file, returning
+   * true if and only if the entire image was written.  The file is
+   * replaced atomically, so Grammars already mapped from it are safe.
+   */
+
+  bool save(const string& imageFileName) const;
+
+  /**
+   * Static Method: isImageFile
+   * --------------------------
+   * Returns true if and only if the specified file begins with the
+   * magic number that marks a precompiled grammar image.
+   */
+
+  static bool isImageFile(const string& fileName);
+
+  /**
+   * Static Methods: isNonterminal, getIndex
+   * ---------------------------------------
+   * Decode a tagged symbol.  isNonterminal reports which table
+   * the symbol refers to, and getIndex returns its position there.
+   */
+
+  static bool isNonterminal(symbol s) { return (s & 1) != 0; }
+  static int getIndex(symbol s) { return s >> 1; }
+
+  /**
+   * Method: lookupNonterminal
+   * -------------------------
+   * Returns the id of the specified nonterminal (spelled with its
+   * '<' and '>'), or -1 if the grammar never mentions it.  This is
+   * a compile-time convenience and isn't meant for the hot path.
+   */
+
+  int lookupNonterminal(string_view name) const;
+
+  /**
+   * Accessors
+   * ---------
+   * Simple accessors into the compiled tables.  Productions belonging
+   * to nonterminal nt are numbered getFirstProduction(nt) through
+   * getFirstProduction(nt) + getNumProductions(nt) - 1, and the symbols
+   * making up production p live in [getProductionBegin(p), getProductionEnd(p)).
+   */
+
+  int getNumNonterminals() const { return numNonterminals; }
+  int getNumTerminals() const { return numTerminals; }
+  int getTotalProductions() const { return numProductions; }
+  string_view getNonterminal(int nt) const
+    { return string_view(nonterminalPool + nonterminalStart[nt], nonterminalStart[nt + 1] - nonterminalStart[nt]); }
+  string_view getTerminal(int t) const
+    { return string_view(terminalPool + terminalStart[t], terminalStart[t + 1] - terminalStart[t]); }
+  int getFirstProduction(int nt) const { return definitionStart[nt]; }
+  int getNumProductions(int nt) const { return definitionStart[nt + 1] - definitionStart[nt]; }
+  const symbol *getProductionBegin(int p) const { return symbols + productionStart[p]; }
+  const symbol *getProductionEnd(int p) const { return symbols + productionStart[p + 1]; }
+  double getWeight(int p) const { return weights[p]; }
+
+  /**
+   * Methods: getAliasThreshold, getAlias
+   * ------------------------------------
+   * Expose entry p of the alias tables getRandomProduction samples
+   * from (see alias.h), for clients like --emit-cpp that want to
+   * reproduce its choices exactly.  Alias entries are relative to the
+   * nonterminal's first production.
+   */
+
+  uint32_t getAliasThreshold(int p) const { return aliasThreshold[p]; }
+  int getAlias(int p) const { return alias[p]; }
+
+  /**
+   * Method: getRandomProduction
+   * ---------------------------
+   * Returns the id of one of the specified nonterminal's productions,
+   * chosen at random with probability proportional to its weight, using
+   * the specified generator.  Each nonterminal's alias table is built
+   * when the grammar is compiled, so this runs in constant time.  It is
+   * assumed that the nonterminal has at least one production.
+   */
+
+  int getRandomProduction(int nt, RandomGenerator& random) const;
+
+ private:
+
+  /**
+   * Struct: tables
+   * --------------
+   * The compiled grammar in easy-to-build form, before it's
+   * packed into an image.
+   */
+
+  struct tables {
+    vector<string> nonterminals;
+    vector<string> terminals;
+    vector<int32_t> definitionStart;   // nonterminal id -> first production id, plus a sentinel
+    vector<int32_t> productionStart;   // production id -> offset into symbols, plus a sentinel
+    vector<symbol> symbols;
+    vector<double> weights;            // production id -> weight
+  };
+
+  // The image is a header followed by a series of 4-byte aligned arrays.
+  // It lives either in image (compiled in memory) or in a read-only
+  // mapping of an image file, and the pointers below address its arrays.
+  vector<char> image;
+  void *mapping;
+  size_t mappingSize;
+  const char *base;
+  size_t size;
+
+  int numNonterminals;
+  int numTerminals;
+  int numProductions;
+  const int32_t *definitionStart;
+  const int32_t *productionStart;
+  const symbol *symbols;
+  const double *weights;               // production id -> weight
+  const uint32_t *aliasThreshold;      // per-definition alias tables over the productions' weights,
+  const int32_t *alias;                // with alias entries relative to the definition's first production
+  const int32_t *nonterminalStart;     // nonterminal id -> offset into nonterminalPool, plus a sentinel
+  const int32_t *terminalStart;        // terminal id -> offset into terminalPool, plus a sentinel
+  const char *nonterminalPool;
+  const char *terminalPool;
+
+  void pack(const tables& compiled);
+  bool attach(const char *data, size_t length);
+
+  // the pointers above address the receiver's own storage,
+  // so Grammars can't be copied or assigned
+  Grammar(const Grammar& original);
+  Grammar& operator=(const Grammar& rhs);
+};
+
+#endif // ! __grammar__
@@ -0,0 +1,293 @@
+/**
+ * File: lengthsampler.cc
+ * ----------------------
+ * Provides the implementation of the LengthSampler class.  Every set
+ * of lengths is a bitset over [0, maxLength], so combining the lengths
+ * of two adjacent symbols (every sum of a length from each, capped at
+ * maxLength) is a handful of shifted ORs per length of the first.
+ */
+
+#include "lengthsampler.h"
+#include <algorithm>
+#include <sstream>
+
+static bool contains(const uint64_t *set, int length)
+{
+  return (set[length >> 6] >> (length & 63)) & 1;
+}
+
+/**
+ * Function: shiftOr
+ * -----------------
+ * ORs src, shifted up by shift lengths, into dest.  Lengths shifted
+ * past the top word fall off; the caller masks off the rest.
+ */
+
+static void shiftOr(uint64_t *dest, const uint64_t *src, int shift, int words)
+{
+  int wordShift = shift >> 6, bitShift = shift & 63;
+  for (int i = words - 1; i >= wordShift; i--) {
+    uint64_t bits = src[i - wordShift] << bitShift;
+    if (bitShift != 0 && i - wordShift > 0) bits |= src[i - wordShift - 1] >> (64 - bitShift);
+    dest[i] |= bits;
+  }
+}
+
+/**
+ * Function: shiftOrEach
+ * ---------------------
+ * ORs into dest a copy of src shifted up by each length in shifts,
+ * which is every sum of a length in src and a length in shifts.  Costs
+ * one shiftOr per length in shifts, so the caller passes whichever set
+ * is new.
+ */
+
+static void shiftOrEach(uint64_t *dest, const uint64_t *src, const uint64_t *shifts, int words)
+{
+  for (int i = 0; i < words; i++)
+    for (uint64_t bits = shifts[i]; bits != 0; bits &= bits - 1)
+      shiftOr(dest, src, i * 64 + __builtin_ctzll(bits), words);
+}
+
+/**
+ * Constructor: LengthSampler
+ * --------------------------
+ * Computes the least fixed point of the achievable-length equations
+ * incrementally: whenever a nonterminal learns new lengths, only those
+ * are combined with the rest of each production it appears in, and only
+ * the lengths that turn out to be new there are carried back toward the
+ * front of the production and, from there, into the nonterminal that
+ * owns it.  Every length enters every set once, so the whole computation
+ * costs about what one sweep over the grammar would.  Lengths reachable
+ * only through an infinite derivation never make it into any set, so
+ * generation can't steer itself into one.
+ */
+
+LengthSampler::LengthSampler(const Grammar& grammar, int minLength, int maxLength, int maxDepth) :
+  grammar(grammar), minLength(minLength), maxLength(maxLength), maxDepth(maxDepth),
+  words(maxLength / 64 + 1)
+{
+  int numNonterminals = grammar.getNumNonterminals();
+  int numProductions = grammar.getTotalProductions();
+  const Grammar::symbol *symbols = grammar.getProductionBegin(0);
+  size_t numSymbols = numProductions == 0 ? 0 : grammar.getProductionEnd(numProductions - 1) - symbols;
+  nonterminalSets.resize((size_t) numNonterminals * words, 0);
+  suffixSets.resize(numSymbols * words, 0);
+
+  // where each nonterminal is mentioned, and which production each position belongs to
+  vector<vector<int> > occurrences(numNonterminals);
+  vector<int> productionOf(numSymbols);
+  for (int p = 0; p < numProductions; p++) {
+    for (const Grammar::symbol *s = grammar.getProductionBegin(p); s != grammar.getProductionEnd(p); s++) {
+      productionOf[s - symbols] = p;
+      if (Grammar::isNonterminal(*s)) occurrences[Grammar::getIndex(*s)].push_back(s - symbols);
+    }
+  }
+
+  vector<int> owner(numProductions);
+  for (int nt = 0; nt < numNonterminals; nt++) {
+    int first = grammar.getFirstProduction(nt);
+    for (int p = first; p < first + grammar.getNumProductions(nt); p++) owner[p] = nt;
+  }
+
+  vector<uint64_t> pendingSets(nonterminalSets.size(), 0);   // lengths not yet passed on to occurrences
+  vector<int> worklist;
+  vector<bool> queued(numNonterminals, false);
+  vector<uint64_t> added(words), sums(words);
+  uint64_t topMask = (maxLength & 63) == 63 ? ~0ULL : (1ULL << ((maxLength & 63) + 1)) - 1;
+
+  // adds the lengths in sums to the suffix set at position pos, and carries
+  // whatever is new there back through the production and into its owner
+  auto carry = [&](size_t pos) {
+    const Grammar::symbol *begin = grammar.getProductionBegin(productionOf[pos]);
+    while (true) {
+      sums[words - 1] &= topMask;
+      uint64_t *dest = &suffixSets[pos * words];
+      bool any = false;
+      for (int i = 0; i < words; i++) {
+        added[i] = sums[i] & ~dest[i];
+        dest[i] |= added[i];
+        any |= added[i] != 0;
+      }
+      if (!any) return;
+      if (symbols + pos == begin) break;
+
+      pos--;
+      fill(sums.begin(), sums.end(), 0);
+      if (Grammar::isNonterminal(symbols[pos])) shiftOrEach(sums.data(), getSet(Grammar::getIndex(symbols[pos])), added.data(), words);
+      else shiftOr(sums.data(), added.data(), 1, words);
+    }
+
+    int nt = owner[productionOf[pos]];
+    for (int i = 0; i < words; i++) {
+      uint64_t fresh = added[i] & ~nonterminalSets[(size_t) nt * words + i];
+      nonterminalSets[(size_t) nt * words + i] |= fresh;
+      pendingSets[(size_t) nt * words + i] |= fresh;
+    }
+    if (!queued[nt]) {
+      queued[nt] = true;
+      worklist.push_back(nt);
+    }
+  };
+
+  // seed with empty productions and with productions ending in a terminal
+  for (int p = 0; p < numProductions; p++) {
+    const Grammar::symbol *begin = grammar.getProductionBegin(p);
+    const Grammar::symbol *end = grammar.getProductionEnd(p);
+    if (begin == end) {
+      nonterminalSets[(size_t) owner[p] * words] |= 1;
+      pendingSets[(size_t) owner[p] * words] |= 1;
+      if (!queued[owner[p]]) {
+        queued[owner[p]] = true;
+        worklist.push_back(owner[p]);
+      }
+    } else if (!Grammar::isNonterminal(end[-1])) {
+      fill(sums.begin(), sums.end(), 0);
+      sums[0] = 2;
+      carry(end - 1 - symbols);
+    }
+  }
+
+  vector<uint64_t> delta(words);
+  while (!worklist.empty()) {
+    int nt = worklist.back();
+    worklist.pop_back();
+    queued[nt] = false;
+    uint64_t *pending = &pendingSets[(size_t) nt * words];
+    copy(pending, pending + words, delta.begin());
+    fill(pending, pending + words, 0);
+    for (int pos : occurrences[nt]) {
+      fill(sums.begin(), sums.end(), 0);
+      if (symbols + pos + 1 == grammar.getProductionEnd(productionOf[pos])) copy(delta.begin(), delta.end(), sums.begin());
+      else shiftOrEach(sums.data(), getSuffixSet(symbols + pos + 1), delta.data(), words);
+      carry(pos);
+    }
+  }
+}
+
+bool LengthSampler::canDerive(Grammar::symbol s, int length) const
+{
+  if (!Grammar::isNonterminal(s)) return length == 1;
+  return contains(getSet(Grammar::getIndex(s)), length);
+}
+
+bool LengthSampler::canDeriveSuffix(const Grammar::symbol *s, const Grammar::symbol *end, int length) const
+{
+  if (s == end) return length == 0;
+  return contains(getSuffixSet(s), length);
+}
+
+bool LengthSampler::canGenerate(int nonterminal) const
+{
+  for (int length = minLength; length <= maxLength; length++)
+    if (contains(getSet(nonterminal), length)) return true;
+  return false;
+}
+
+/**
+ * Method: expand
+ * --------------
+ * Chooses a production of the task's nonterminal that can derive
+ * exactly the task's length, weighting the candidates by their
+ * production weights, then deals that length out across the
+ * production's symbols left to right and pushes a task for each.
+ */
+
+bool LengthSampler::expand(const task& t)
+{
+  int nt = Grammar::getIndex(t.s);
+  int first = grammar.getFirstProduction(nt);
+  int last = first + grammar.getNumProductions(nt);
+  double total = 0;
+  for (int p = first; p < last; p++)
+    if (canDeriveSuffix(grammar.getProductionBegin(p), grammar.getProductionEnd(p), t.length))
+      total += grammar.getWeight(p);
+
+  double r = (random.next() >> 11) * 0x1.0p-53 * total;
+  int chosen = -1;
+  for (int p = first; p < last; p++) {
+    if (!canDeriveSuffix(grammar.getProductionBegin(p), grammar.getProductionEnd(p), t.length)) continue;
+    chosen = p;
+    if (r < grammar.getWeight(p)) break;
+    r -= grammar.getWeight(p);
+  }
+
+  const Grammar::symbol *begin = grammar.getProductionBegin(chosen);
+  const Grammar::symbol *end = grammar.getProductionEnd(chosen);
+  children.clear();
+  int remaining = t.length;
+  for (const Grammar::symbol *s = begin; s != end; s++) {
+    int length = remaining;
+    if (s + 1 != end) {
+      int choices = 0;
+      for (int l = 0; l <= remaining; l++)
+        if (canDerive(*s, l) && canDeriveSuffix(s + 1, end, remaining - l)) choices++;
+      int pick = random.getRandomIndex(choices);
+      for (length = 0; ; length++)
+        if (canDerive(*s, length) && canDeriveSuffix(s + 1, end, remaining - length) && pick-- == 0) break;
+    }
+    task child = { *s, length };
+    children.push_back(child);
+    remaining -= length;
+  }
+
+  if ((int) (stack.size() + children.size()) > maxDepth) {
+    ostringstream message;
+    message << "Expansion exceeded the maximum depth of " << maxDepth
+            << " pending symbols while expanding \"" << grammar.getNonterminal(nt) << "\".";
+    error = message.str();
+    return false;
+  }
+
+  stack.insert(stack.end(), children.rbegin(), children.rend());
+  return true;
+}
+
+/**
+ * Method: generate
+ * ----------------
+ * Draws the sentence's length uniformly from the achievable lengths in
+ * the window, then expands tasks off an explicit stack until none remain.
+ */
+
+bool LengthSampler::generate(int nonterminal, OutputBuffer& out)
+{
+  error.clear();
+  const uint64_t *set = getSet(nonterminal);
+  int choices = 0;
+  for (int length = minLength; length <= maxLength; length++)
+    if (contains(set, length)) choices++;
+  if (choices == 0) {
+    ostringstream message;
+    message << "\"" << grammar.getNonterminal(nonterminal) << "\" can't derive a sentence of between "
+            << minLength << " and " << maxLength << " terminals.";
+    error = message.str();
+    return false;
+  }
+
+  int pick = random.getRandomIndex(choices);
+  int target = minLength;
+  while (!contains(set, target) || pick-- > 0) target++;
+
+  size_t mark = out.size();
+  bool first = true;
+  stack.clear();
+  task root = { (nonterminal << 1) | 1, target };
+  stack.push_back(root);
+  while (!stack.empty()) {
+    task t = stack.back();
+    stack.pop_back();
+    if (Grammar::isNonterminal(t.s)) {
+      if (!expand(t)) {
+        out.truncate(mark);
+        return false;
+      }
+    } else {
+      if (!first) out.append(' ');
+      out.append(grammar.getTerminal(Grammar::getIndex(t.s)));
+      first = false;
+    }
+  }
+
+  return true;
+}
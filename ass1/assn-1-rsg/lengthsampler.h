@@ -0,0 +1,120 @@
+#ifndef __lengthsampler__
+#define __lengthsampler__
+
+/**
+ * File: lengthsampler.h
+ * ---------------------
+ * Defines the LengthSampler class, which generates random sentences
+ * whose length (in terminals) falls inside a requested window, in a
+ * single pass, rather than by generating sentences and throwing away
+ * the ones that come out too long or too short.
+ *
+ * Up front, the sampler works out, for every nonterminal and every
+ * suffix of every production, exactly which lengths up to the window's
+ * upper bound it can derive.  Generation then fixes a target length and
+ * only ever makes choices that can still reach it: productions are drawn
+ * (by weight) from those that can produce the length being asked of them,
+ * and that length is split across the production's symbols so that every
+ * symbol is asked for a length it can produce.
+ *
+ * The result is always in the window, but the sampler doesn't reproduce
+ * the distribution of rejection sampling: target lengths are drawn
+ * uniformly from the achievable ones, and so are the splits.
+ */
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include "grammar.h"
+#include "output.h"
+#include "random.h"
+using namespace std;
+
+class LengthSampler {
+
+ public:
+
+  /**
+   * Constructor: LengthSampler
+   * --------------------------
+   * Constructs a LengthSampler layered over the specified Grammar, which
+   * must outlive it, and computes the achievable lengths.  That takes
+   * time roughly proportional to the size of the grammar times maxLength
+   * squared over 64, and memory proportional to the size of the grammar
+   * times maxLength over 8 bytes.
+   *
+   * @param grammar the compiled grammar to expand.
+   * @param minLength the fewest terminals a sentence may contain.
+   * @param maxLength the most terminals a sentence may contain.
+   * @param maxDepth the maximum number of symbols that may be
+   *                 simultaneously pending expansion.
+   */
+
+  LengthSampler(const Grammar& grammar, int minLength, int maxLength, int maxDepth);
+
+  /**
+   * Method: canGenerate
+   * -------------------
+   * Returns true if and only if the specified nonterminal can derive
+   * some sentence whose length falls within the window.
+   */
+
+  bool canGenerate(int nonterminal) const;
+
+  /**
+   * Method: generate
+   * ----------------
+   * Expands the specified nonterminal into a random sentence whose length
+   * falls within the window, appending its terminals (separated by single
+   * spaces) to out, just as Generator::generate does.  Returns false, with
+   * nothing appended, if no such sentence exists or the expansion exceeds
+   * maxDepth; getError then describes what went wrong.
+   */
+
+  bool generate(int nonterminal, OutputBuffer& out);
+
+  /**
+   * Method: getError
+   * ----------------
+   * Returns a human-readable description of why the most recent
+   * call to generate failed.
+   */
+
+  const string& getError() const { return error; }
+
+  /**
+   * Method: seed
+   * ------------
+   * Restarts the sampler's private random sequence from the specified
+   * seed and stream number.
+   */
+
+  void seed(uint64_t seed, uint64_t stream = 0) { random = RandomGenerator(seed, stream); }
+
+ private:
+  struct task {
+    Grammar::symbol s;
+    int length;       // exact number of terminals s must derive
+  };
+
+  const Grammar& grammar;
+  int minLength;
+  int maxLength;
+  int maxDepth;
+  int words;                         // 64-bit words per set of lengths
+  vector<uint64_t> nonterminalSets;  // [nt * words, (nt + 1) * words): lengths nt can derive
+  vector<uint64_t> suffixSets;       // likewise per symbol position: lengths the rest of its production can derive
+  RandomGenerator random;
+  vector<task> stack;
+  vector<task> children;
+  string error;
+
+  const uint64_t *getSet(int nonterminal) const { return &nonterminalSets[(size_t) nonterminal * words]; }
+  const uint64_t *getSuffixSet(const Grammar::symbol *s) const
+    { return &suffixSets[(size_t) (s - grammar.getProductionBegin(0)) * words]; }
+  bool canDerive(Grammar::symbol s, int length) const;
+  bool canDeriveSuffix(const Grammar::symbol *s, const Grammar::symbol *end, int length) const;
+  bool expand(const task& t);
+};
+
+#endif // ! __lengthsampler__
@@ -0,0 +1,100 @@
+/**
+ * File: loader.cc
+ * ---------------
+ * Provides the implementation of readGrammar and loadGrammar, which
+ * are shared by rsg itself and the rsg-bench benchmark.  rsg no longer
+ * reads through readGrammar, but rsg-bench still times it as a baseline.
+ */
+
+#include "loader.h"
+#include <iostream>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+using namespace std;
+
+/**
+ * Takes a reference to a legitimate infile (one that's been set up
+ * to layer over a file) and populates the grammar map with the
+ * collection of definitions that are spelled out in the referenced
+ * file.  The function is written under the assumption that the
+ * referenced data file is really a grammar file that's properly
+ * formatted.  You may assume that all grammars are in fact properly
+ * formatted.
+ *
+ * @param infile a valid reference to a flat text file storing the grammar.
+ * @param grammar a reference to the STL map, which maps nonterminal strings
+ *                to their definitions.
+ */
+
+void readGrammar(ifstream& infile, map<string, Definition>& grammar)
+{
+  while (true) {
+    string uselessText;
+    getline(infile, uselessText, '{');
+    if (infile.eof()) return;  // true? we encountered EOF before we saw a '{': no more productions!
+    infile.putback('{');
+    Definition def(infile);
+    grammar[def.getNonterminal()] = def;
+  }
+}
+
+/**
+ * Loads the named grammar, printing whatever error message the
+ * second version of loadGrammar produces.
+ */
+
+Grammar *loadGrammar(const char *fileName)
+{
+  string error;
+  Grammar *grammar = loadGrammar(fileName, error);
+  if (grammar == NULL) cerr << error << endl;
+  return grammar;
+}
+
+/**
+ * Loads the named grammar, which may either be a text grammar (which
+ * is mapped into memory and handed to Grammar's parsing constructor)
+ * or a precompiled image (which is simply mapped into memory).  Returns NULL after setting
+ * error if the file can't be used.
+ */
+
+Grammar *loadGrammar(const char *fileName, string& error)
+{
+  if (Grammar::isImageFile(fileName)) {
+    Grammar *grammar = new Grammar(string(fileName));
+    if (grammar->good()) return grammar;
+    error = "The file named \"" + string(fileName) + "\" isn't a grammar image this version of rsg understands.  Recompile it with --compile. ";
+    delete grammar;
+    return NULL;
+  }
+
+  int fd = open(fileName, O_RDONLY);
+  struct stat stats;
+  if (fd == -1 || fstat(fd, &stats) == -1) {
+    if (fd != -1) close(fd);
+    error = "Failed to open the file named \"" + string(fileName) + "\".  Check to ensure the file exists. ";
+    return NULL;
+  }
+
+  if (stats.st_size == 0) {
+    close(fd);
+    return new Grammar();   // nothing to map, and nothing defined
+  }
+
+  // the whole file is scanned front to back exactly once
+  void *text = mmap(NULL, stats.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  int mapError = errno;
+  close(fd);
+  if (text == MAP_FAILED) {
+    error = "Failed to read the file named \"" + string(fileName) + "\": " + strerror(mapError) + ". ";
+    return NULL;
+  }
+  madvise(text, stats.st_size, MADV_SEQUENTIAL);
+  Grammar *grammar = new Grammar((const char *) text, stats.st_size);
+  munmap(text, stats.st_size);
+  return grammar;
+}
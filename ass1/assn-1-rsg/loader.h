@@ -0,0 +1,50 @@
+#ifndef __loader__
+#define __loader__
+
+/**
+ * File: loader.h
+ * --------------
+ * Defines the routines that turn a grammar file on disk into a
+ * compiled Grammar.  They live apart from rsg.cc so that anything
+ * else that needs to read grammars (rsg-bench in particular) goes
+ * through exactly the same code.
+ */
+
+#include <fstream>
+#include <map>
+#include <string>
+#include "definition.h"
+#include "grammar.h"
+using namespace std;
+
+/**
+ * Function: readGrammar
+ * ---------------------
+ * Populates the map with the definitions spelled out in the
+ * specified text grammar file.
+ */
+
+void readGrammar(ifstream& infile, map<string, Definition>& grammar);
+
+/**
+ * Function: loadGrammar
+ * ---------------------
+ * Loads the named grammar, which may either be a text grammar or a
+ * precompiled image.  The Grammar is dynamically allocated and owned
+ * by the caller.  Returns NULL after printing an error message if the
+ * file can't be used.
+ */
+
+Grammar *loadGrammar(const char *fileName);
+
+/**
+ * Function: loadGrammar
+ * ---------------------
+ * Like the version above, except that rather than printing an error
+ * message, it stores it in error, for clients (like the --serve daemon)
+ * that have somewhere else to report it.
+ */
+
+Grammar *loadGrammar(const char *fileName, string& error);
+
+#endif // ! __loader__
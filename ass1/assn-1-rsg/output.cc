@@ -0,0 +1,92 @@
+/**
+ * File: output.cc
+ * ---------------
+ * Provides the implementation of the OutputBuffer class and
+ * the writeBuffers routine.
+ */
+
+#include "output.h"
+#include <algorithm>
+#include <utility>
+#include <errno.h>
+#include <limits.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+OutputBuffer::OutputBuffer(int fd, size_t capacity) : buffer(capacity), used(0), fd(fd) {}
+
+OutputBuffer::~OutputBuffer()
+{
+  flush();
+}
+
+/**
+ * Method: makeRoom
+ * ----------------
+ * Called when the next append wouldn't fit.  Buffers attached to a
+ * file descriptor drain first, and only grow if the pending append is
+ * bigger than the whole buffer.  Detached buffers just double.
+ */
+
+void OutputBuffer::makeRoom(size_t needed)
+{
+  if (fd != -1) {
+    flush();
+    if (needed <= buffer.size()) return;
+  }
+  size_t capacity = buffer.size() == 0 ? kDefaultCapacity : buffer.size();
+  while (capacity < used + needed) capacity *= 2;
+  buffer.resize(capacity);
+}
+
+bool OutputBuffer::flush()
+{
+  if (fd == -1 || used == 0) return true;
+  const OutputBuffer *self = this;
+  bool succeeded = writeBuffers(fd, &self, 1);
+  used = 0;
+  return succeeded;
+}
+
+void OutputBuffer::swap(OutputBuffer& other)
+{
+  buffer.swap(other.buffer);
+  std::swap(used, other.used);
+}
+
+/**
+ * Function: writeBuffers
+ * ----------------------
+ * Builds one iovec per nonempty buffer and hands as many as the
+ * kernel allows to writev.  Partial writes are resumed by advancing
+ * past whatever was consumed, and EINTR is simply retried.
+ */
+
+bool writeBuffers(int fd, const OutputBuffer *const *buffers, int count)
+{
+  vector<iovec> pieces;
+  for (int i = 0; i < count; i++) {
+    if (buffers[i]->size() == 0) continue;
+    iovec piece = { (void *) buffers[i]->data(), buffers[i]->size() };
+    pieces.push_back(piece);
+  }
+
+  size_t first = 0;
+  while (first < pieces.size()) {
+    int numPieces = min(pieces.size() - first, (size_t) IOV_MAX);
+    ssize_t written = writev(fd, &pieces[first], numPieces);
+    if (written < 0) {
+      if (errno == EINTR) continue;
+      return false;
+    }
+
+    while (first < pieces.size() && (size_t) written >= pieces[first].iov_len)
+      written -= pieces[first++].iov_len;
+    if (written > 0) {
+      pieces[first].iov_base = (char *) pieces[first].iov_base + written;
+      pieces[first].iov_len -= written;
+    }
+  }
+
+  return true;
+}
@@ -0,0 +1,135 @@
+#ifndef __output__
+#define __output__
+
+/**
+ * File: output.h
+ * --------------
+ * Defines the OutputBuffer class, a large, reusable byte buffer into
+ * which generated sentences are assembled.  Terminals are copied
+ * straight out of the Grammar's terminal pool into the buffer, and
+ * the buffer reaches the file descriptor in as few write calls as
+ * possible, rather than once per line as with cout << ... << endl.
+ */
+
+#include <string_view>
+#include <vector>
+#include <stddef.h>
+#include <string.h>
+using namespace std;
+
+class OutputBuffer {
+
+ public:
+
+  /**
+   * Constant: kDefaultCapacity
+   * --------------------------
+   * The number of bytes an OutputBuffer sets aside the first time
+   * it's written to, unless told otherwise.
+   */
+
+  static const size_t kDefaultCapacity = 1 << 20;
+
+  /**
+   * Constructor: OutputBuffer
+   * -------------------------
+   * Constructs an empty buffer.  If fd is a valid file descriptor, the
+   * buffer drains itself into fd whenever an append would overflow it;
+   * otherwise it simply grows, and it's up to the client to call
+   * writeBuffers (or read data/size) to do something with the contents.
+   *
+   * @param fd the file descriptor to drain into, or -1 for none.
+   * @param capacity the number of bytes to reserve up front; if 0,
+   *                 kDefaultCapacity bytes are reserved on first use.
+   */
+
+  OutputBuffer(int fd = -1, size_t capacity = 0);
+
+  /**
+   * Destructor: ~OutputBuffer
+   * -------------------------
+   * Flushes anything still pending if the buffer is attached
+   * to a file descriptor.
+   */
+
+  ~OutputBuffer();
+
+  /**
+   * Methods: append
+   * ---------------
+   * Appends the specified bytes to the end of the buffer.  These are
+   * the hot path of generation, so they're inlined, and the rare overflow
+   * case is handed off to makeRoom.
+   */
+
+  void append(string_view text)
+  {
+    if (used + text.size() > buffer.size()) makeRoom(text.size());
+    memcpy(buffer.data() + used, text.data(), text.size());
+    used += text.size();
+  }
+
+  void append(char ch)
+  {
+    if (used == buffer.size()) makeRoom(1);
+    buffer[used++] = ch;
+  }
+
+  /**
+   * Methods: data, size, clear, truncate
+   * ------------------------------------
+   * data and size expose the bytes currently held.  clear discards
+   * all of them, and truncate discards everything past the first
+   * size bytes, which lets a client back out a partial sentence.
+   * Neither releases any memory.
+   */
+
+  const char *data() const { return buffer.data(); }
+  size_t size() const { return used; }
+  void clear() { used = 0; }
+  void truncate(size_t size) { if (size < used) used = size; }
+
+  /**
+   * Method: flush
+   * -------------
+   * Writes everything held to the attached file descriptor (if any)
+   * and empties the buffer.  Returns false if the write fails.
+   */
+
+  bool flush();
+
+  /**
+   * Method: swap
+   * ------------
+   * Exchanges contents (and capacity) with the specified buffer.  The
+   * file descriptors stay put.
+   */
+
+  void swap(OutputBuffer& other);
+
+ private:
+  vector<char> buffer;
+  size_t used;
+  int fd;
+
+  void makeRoom(size_t needed);
+
+  // copying would make two buffers drain into the same descriptor
+  OutputBuffer(const OutputBuffer& original);
+  OutputBuffer& operator=(const OutputBuffer& rhs);
+};
+
+/**
+ * Function: writeBuffers
+ * ----------------------
+ * Writes the contents of the specified buffers to fd, in order,
+ * using a single writev call when the kernel accepts everything at
+ * once (and as few follow-up calls as necessary when it doesn't).
+ * The buffers themselves are left untouched.
+ *
+ * @return true if and only if every byte was written.
+ */
+
+bool writeBuffers(int fd, const OutputBuffer *const *buffers, int count);
+
+#endif // ! __output__
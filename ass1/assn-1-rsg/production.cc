@@ -8,6 +8,9 @@
  */
 
 #include "production.h"
+#include <ctype.h>
+#include <math.h>
+#include <stdlib.h>
 
 /**
  * Constructor Implementation: Production
@@ -27,16 +30,36 @@
  * something else if you'd like to.
  */
 
-Production::Production(ifstream& infile)  // phrases is constructed, size is 0
+Production::Production(ifstream& infile) : weight(1.0)  // phrases is constructed, size is 0
 {
+  bool first = true;
   while (true) {
     string token;
     infile >> token;  // ignores whitespace by default
     if (token == ";") break;
-    phrases.push_back(token);
+    if (!(first && parseWeight(token, weight))) phrases.push_back(token);
+    first = false;
   }
   
   string uselessText;
   getline(infile, uselessText); // read everything else as if it's important
   // oh, no it's not.. it's useless.. but we're glad it's been pulled from the stream..
 }
+
+/**
+ * Static Method: parseWeight
+ * --------------------------
+ * Leans on strtod to do the number parsing, and insists that
+ * it consume everything between the brackets.
+ */
+
+bool Production::parseWeight(const string& token, double& weight)
+{
+  if (token.size() < 3 || token[0] != '[' || token[token.size() - 1] != ']') return false;
+  string number = token.substr(1, token.size() - 2);
+  char *end;
+  double value = strtod(number.c_str(), &end);
+  if (*end != '\0' || !(value >= 0) || isinf(value) || isspace(number[0])) return false;
+  weight = value;
+  return true;
+}
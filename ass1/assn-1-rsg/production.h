@@ -44,7 +44,7 @@ class Production {
    * have a default constructor.
    */
   
-  Production() {}
+  Production() : weight(1.0) {}
   
   /**
    * ifstream Constructor: Production
@@ -54,7 +54,9 @@ class Production {
    * positions at the start of a line that houses a production.
    * Leading whitespace is discarded, the series of terminals and
    * non-terminals are read in until a semicolon is consumed, and
-   * the the rest of the data is discarded.
+   * the the rest of the data is discarded.  If the very first token
+   * is a bracketed, non-negative number (as in "[3] <verb> tonight ;"),
+   * it's taken to be the Production's weight rather than a terminal.
    */
   
   Production(ifstream& infile);
@@ -66,7 +68,26 @@ class Production {
    * a copy of the provided vector.
    */
   
-  Production(const vector<string>& words) : phrases(words) {}
+  Production(const vector<string>& words, double weight = 1.0) : phrases(words), weight(weight) {}
+
+  /**
+   * Method: getWeight
+   * -----------------
+   * Returns the Production's relative weight.  A Definition chooses
+   * each of its Productions with probability proportional to its weight.
+   * Productions without an explicit weight have weight 1.
+   */
+
+  double getWeight() const { return weight; }
+
+  /**
+   * Static Method: parseWeight
+   * --------------------------
+   * Returns true and sets weight if the specified token is a weight
+   * annotation: '[', a non-negative number, and ']', with no spaces.
+   */
+
+  static bool parseWeight(const string& token, double& weight);
   
   /**
    * Iterators: begin, end
@@ -93,6 +114,7 @@ class Production {
   
  private:
   vector<string> phrases;
+  double weight;
 };
 
 #endif
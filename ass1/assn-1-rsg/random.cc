@@ -1,9 +1,23 @@
 #include <time.h>
-#include <stdlib.h>
-#include <limits.h>
 #include <cassert> // for assert macro
 #include "random.h"
 
+/**
+ * Function: splitmix64
+ * --------------------
+ * Advances the specified 64-bit counter and returns a thoroughly
+ * scrambled version of it.  This is the seeding routine recommended
+ * by the xoshiro authors, since it never yields the all-zero state.
+ */
+
+static uint64_t splitmix64(uint64_t& x)
+{
+  uint64_t z = (x += 0x9E3779B97F4A7C15ULL);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
 /**
  * Constructor: RandomGenerator
  * ----------------------------
@@ -15,23 +29,41 @@
 
 RandomGenerator::RandomGenerator()
 {
-  srand(time(NULL));
+  seed(time(NULL), 0);
+}
+
+RandomGenerator::RandomGenerator(uint64_t seedValue, uint64_t stream)
+{
+  seed(seedValue, stream);
+}
+
+/**
+ * Method: seed
+ * ------------
+ * Fills the state from a splitmix64 sequence whose starting point
+ * mixes the seed with the stream number.  The stream number is itself
+ * scrambled first, so consecutive streams land far apart.
+ */
+
+void RandomGenerator::seed(uint64_t seedValue, uint64_t stream)
+{
+  uint64_t streamMix = stream;
+  uint64_t x = seedValue ^ splitmix64(streamMix);
+  for (int i = 0; i < 4; i++)
+    s[i] = splitmix64(x);
 }
 
 /**
  * Method: getRandomInteger
  * ------------------------
  * Returns a seemingly random number between
- * the specified low and high, inclusive.  Based
- * on Eric Roberts' implementation from his
- * CS106A text.
+ * the specified low and high, inclusive.  Defers
+ * to getRandomIndex, so every value in the range
+ * is exactly equally likely.
  */
 
 int RandomGenerator::getRandomInteger(int low, int high)
 {
   assert(low <= high);
-  double percent = (rand() / (static_cast<double>(RAND_MAX) + 1));
-  assert(percent >= 0.0 && percent < 1.0); 
-  int offset = static_cast<int>(percent * (high - low + 1));
-  return low + offset;
+  return low + (int) getRandomIndex((uint32_t) high - (uint32_t) low + 1);
 }
@@ -6,8 +6,15 @@
  * --------------
  * Provides a random number generator so
  * that pseudo-random numbers can be produced.
+ * Each RandomGenerator is a self-contained
+ * xoshiro256** stream: there's no global state,
+ * so separate threads can each own a generator,
+ * and a generator built from a given seed and
+ * stream number always produces the same sequence.
  */
 
+#include <stdint.h>
+
 class RandomGenerator {
   
  public: 
@@ -15,11 +22,23 @@ class RandomGenerator {
   /**
    * Constructor: RandomGenerator
    * ----------------------------
-   * Constructs a new RandomGenerator object.
+   * Constructs a new RandomGenerator object seeded
+   * from the current time.
    */
   
   RandomGenerator();
 
+  /**
+   * Seeded Constructor: RandomGenerator
+   * -----------------------------------
+   * Constructs a new RandomGenerator object whose sequence is
+   * entirely determined by the specified seed and stream number.
+   * Generators sharing a seed but built for different streams
+   * produce unrelated sequences.
+   */
+
+  RandomGenerator(uint64_t seed, uint64_t stream = 0);
+
   /**
    * Method: getRandomInteger
    * ------------------------
@@ -35,7 +54,75 @@ class RandomGenerator {
    */
   
   int getRandomInteger(int low, int high);  
+
+  /**
+   * Method: getRandomIndex
+   * ----------------------
+   * Returns a number drawn uniformly from [0, n), where n must be
+   * positive.  Uses Lemire's multiply-and-reject method, so the result
+   * carries no modulo bias and almost never costs more than a single
+   * multiplication.
+   */
+
+  uint32_t getRandomIndex(uint32_t n)
+  {
+    uint64_t product = (next() >> 32) * n;
+    uint32_t leftover = (uint32_t) product;
+    if (leftover < n) {
+      uint32_t threshold = -n % n;
+      while (leftover < threshold) {
+        product = (next() >> 32) * n;
+        leftover = (uint32_t) product;
+      }
+    }
+    return product >> 32;
+  }
+
+  /**
+   * Method: getRandomIndex64
+   * ------------------------
+   * The 64-bit analogue of getRandomIndex: returns a number drawn
+   * uniformly from [0, n), where n must be positive.
+   */
+
+  uint64_t getRandomIndex64(uint64_t n)
+  {
+    unsigned __int128 product = (unsigned __int128) next() * n;
+    uint64_t leftover = (uint64_t) product;
+    if (leftover < n) {
+      uint64_t threshold = -n % n;
+      while (leftover < threshold) {
+        product = (unsigned __int128) next() * n;
+        leftover = (uint64_t) product;
+      }
+    }
+    return product >> 64;
+  }
+
+  /**
+   * Method: next
+   * ------------
+   * Advances the stream and returns the next 64 random bits.
+   */
+
+  uint64_t next()
+  {
+    uint64_t result = rotl(s[1] * 5, 7) * 9;
+    uint64_t t = s[1] << 17;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotl(s[3], 45);
+    return result;
+  }
+
+ private:
+  uint64_t s[4];
+
+  static uint64_t rotl(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+  void seed(uint64_t seed, uint64_t stream);
 };
 
 #endif // ! __random__
-
@@ -0,0 +1,52 @@
+/**
+ * File: rsg-test.cc
+ * -----------------
+ * Provides the implementation of rsg-test, which runs a handful of
+ * regression tests for corners of rsg that are hard to reach by just
+ * running it: races that depend on thread timing, for instance.  Each
+ * test prints a line saying whether it passed, and the exit status is
+ * nonzero if any failed.  make check runs it, along with the scripts
+ * that test rsg end to end.
+ */
+
+#include "batch.h"
+#include <iostream>
+#include <vector>
+using namespace std;
+
+static int numFailed = 0;
+
+static void expect(bool condition, const char *description)
+{
+  cout << (condition ? "PASS " : "FAIL ") << description << endl;
+  if (!condition) numFailed++;
+}
+
+/**
+ * Function: testReadyChunks
+ * -------------------------
+ * The writer in generateBatch drains every consecutive ready chunk at
+ * once.  When workers have filled the whole ring before the writer
+ * looks, the scan mustn't wrap around and pick up the ring's first slots
+ * again as though they held the chunks one ring later.
+ */
+
+static void testReadyChunks()
+{
+  vector<bool> full(8, true);
+  expect(countReadyChunks(full, 0, 100) == 8, "a full ring is drained once, not twice");
+  expect(countReadyChunks(full, 13, 100) == 8, "a full ring starting mid-ring is drained once");
+  expect(countReadyChunks(full, 95, 100) == 5, "the scan stops at the last chunk");
+
+  vector<bool> partial(8, true);
+  partial[3] = false;
+  expect(countReadyChunks(partial, 0, 100) == 3, "the scan stops at the first empty slot");
+  expect(countReadyChunks(partial, 4, 100) == 7, "the scan wraps around to reach later chunks");
+  expect(countReadyChunks(partial, 3, 100) == 0, "nothing is drained when the next chunk isn't ready");
+}
+
+int main()
+{
+  testReadyChunks();
+  return numFailed == 0 ? 0 : 1;
+}
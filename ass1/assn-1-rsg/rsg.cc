@@ -11,36 +11,335 @@
 #include <fstream>
 #include "definition.h"
 #include "production.h"
+#include "grammar.h"
+#include "generator.h"
+#include "batch.h"
+#include "output.h"
+#include "analysis.h"
+#include "enumerator.h"
+#include "loader.h"
+#include "server.h"
+#include "lengthsampler.h"
+#include "emitter.h"
+#include "seenset.h"
 #include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <time.h>
+#include <stdio.h>
+#include <unistd.h>
 using namespace std;
 
-/* Prototypes */
-void getExtensions(string def_id, map<string, Definition> &grammar, string &curr, int &exit_code);
+/**
+ * Struct: options
+ * ---------------
+ * Bundles everything the user may specify on the command line.
+ */
+
+struct options {
+  const char *grammarFileName;
+  int maxDepth;
+  long maxLength;
+  long count;           // 0 means the classic three-version output
+  int numThreads;
+  bool unordered;
+  uint64_t seed;
+  bool compile;         // write a precompiled image instead of generating
+  bool emitCpp;         // write a C++ program instead of generating
+  const char *outputFileName;   // where --compile and --emit-cpp write
+  bool check;           // print the grammar analysis instead of generating
+  double budget;        // largest acceptable expected sentence length, or 0 for no limit
+  enum { kRandom, kCount, kEnumerate, kUniform } derivations;
+  int derivationDepth;  // depth limit for --count, --enumerate and --uniform
+  uint64_t firstRank;   // first rank written by --enumerate
+  bool unique;          // skip sentences already written
+  int minWords;         // shortest sentence --max-words mode may produce
+  int maxWords;         // longest sentence, or 0 for no length window
+  const char *serveSocket;    // run as a daemon on this socket
+  const char *requestSocket;  // ask the daemon on this socket instead of generating
+};
+
+/**
+ * Constant: kMaxServedCount
+ * -------------------------
+ * The most sentences the daemon will produce for one request, so that
+ * no one request can tie up a generation thread indefinitely.
+ */
+
+static const long kMaxServedCount = 10000000;
+
+/**
+ * Constant: kMaxDuplicateRun
+ * --------------------------
+ * The number of repeats in a row after which --unique concludes that
+ * the grammar has (nearly) run out of new sentences and gives up.
+ */
+
+static const long kMaxDuplicateRun = 100000;
 
 /**
- * Takes a reference to a legitimate infile (one that's been set up
- * to layer over a file) and populates the grammar map with the
- * collection of definitions that are spelled out in the referenced
- * file.  The function is written under the assumption that the
- * referenced data file is really a grammar file that's properly
- * formatted.  You may assume that all grammars are in fact properly
- * formatted.
+ * Constant: kMaxWindowWords
+ * -------------------------
+ * The largest --max-words accepted.  The LengthSampler's setup takes
+ * time proportional to the size of the grammar times --max-words squared
+ * over 64 (about a second for kant.g at 20000), so the window is capped
+ * well short of anything that would stall for minutes.
+ */
+
+static const int kMaxWindowWords = 50000;
+
+/**
+ * Parses the command line into the specified options struct,
+ * returning false if the command line is malformed.  Flags may
+ * appear before or after the name of the grammar file:
+ *
+ *    --max-depth N     cap on the number of pending productions
+ *    --max-length N    cap on the number of terminals per sentence
+ *    -n COUNT          generate COUNT sentences, one per line
+ *    -j THREADS        shard -n generation across THREADS workers (0: one per core)
+ *    --unordered       write batches as they finish instead of in order
+ *    --seed S          seed the random streams (default: the current time)
+ *    --compile -o FILE precompile the grammar into a binary image in FILE
+ *    --emit-cpp -o FILE
+ *                      write a standalone C++ program generating from the
+ *                      grammar (reweighted by --budget, if given) to FILE
+ *    --check           report undefined, unreachable and nonterminating
+ *                      nonterminals and expected lengths, then exit
+ *    --budget N        bias choices toward termination if the expected
+ *                      sentence length exceeds N terminals
+ *    --count D         print the number of derivations of depth at most D
+ *    --enumerate D     write every derivation of depth at most D, in rank
+ *                      order, or just -n of them starting at --from K
+ *    --uniform D       write -n derivations of depth at most D, each drawn
+ *                      uniformly from all of them
+ *    --unique          with -n, write COUNT distinct sentences (on one thread),
+ *                      then report how many repeats were skipped
+ *    --min-words N     with --max-words, the fewest terminals per sentence
+ *    --max-words N     generate only sentences of at most N terminals (and
+ *                      at least --min-words), in one pass, without rejection;
+ *                      setup grows with N squared, and N is capped at
+ *                      kMaxWindowWords
+ *    --serve SOCKET    run as a daemon serving requests on SOCKET, generating
+ *                      on -j threads (default: one per core); no grammar
+ *                      file is given
+ *    --request SOCKET  have the daemon on SOCKET produce the -n sentences
  *
- * @param infile a valid reference to a flat text file storing the grammar.
- * @param grammar a reference to the STL map, which maps nonterminal strings
- *                to their definitions.
+ * The grammar file may be either a text grammar or an image written by --compile.
  */
 
-static void readGrammar(ifstream& infile, map<string, Definition>& grammar)
+static bool parseOptions(int argc, char *argv[], options& opts)
 {
-  while (true) {
-    string uselessText;
-    getline(infile, uselessText, '{');
-    if (infile.eof()) return;  // true? we encountered EOF before we saw a '{': no more productions!
-    infile.putback('{');
-    Definition def(infile);
-    grammar[def.getNonterminal()] = def;
+  opts.grammarFileName = NULL;
+  opts.maxDepth = Generator::kDefaultMaxDepth;
+  opts.maxLength = Generator::kDefaultMaxLength;
+  opts.count = 0;
+  opts.numThreads = -1;   // until -j says otherwise
+  opts.unordered = false;
+  opts.seed = time(NULL);
+  opts.compile = false;
+  opts.emitCpp = false;
+  opts.outputFileName = NULL;
+  opts.check = false;
+  opts.budget = 0;
+  opts.derivations = options::kRandom;
+  opts.derivationDepth = 0;
+  opts.firstRank = 0;
+  opts.unique = false;
+  opts.minWords = 0;
+  opts.maxWords = 0;
+  opts.serveSocket = NULL;
+  opts.requestSocket = NULL;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--max-depth") == 0 && i + 1 < argc) {
+      opts.maxDepth = atoi(argv[++i]);
+      if (opts.maxDepth <= 0) return false;
+    } else if (strcmp(argv[i], "--max-length") == 0 && i + 1 < argc) {
+      opts.maxLength = atol(argv[++i]);
+      if (opts.maxLength <= 0) return false;
+    } else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+      opts.count = atol(argv[++i]);
+      if (opts.count <= 0) return false;
+    } else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+      opts.numThreads = atoi(argv[++i]);
+      if (opts.numThreads < 0) return false;
+      if (opts.numThreads == 0) opts.numThreads = max(1u, thread::hardware_concurrency());
+    } else if (strcmp(argv[i], "--unordered") == 0) {
+      opts.unordered = true;
+    } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+      char *end;
+      opts.seed = strtoull(argv[++i], &end, 0);
+      if (*end != '\0') return false;
+    } else if (strcmp(argv[i], "--compile") == 0) {
+      opts.compile = true;
+    } else if (strcmp(argv[i], "--emit-cpp") == 0) {
+      opts.emitCpp = true;
+    } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+      opts.outputFileName = argv[++i];
+    } else if (strcmp(argv[i], "--check") == 0) {
+      opts.check = true;
+    } else if (strcmp(argv[i], "--budget") == 0 && i + 1 < argc) {
+      opts.budget = atof(argv[++i]);
+      if (opts.budget <= 0) return false;
+    } else if ((strcmp(argv[i], "--count") == 0 || strcmp(argv[i], "--enumerate") == 0 ||
+                strcmp(argv[i], "--uniform") == 0) && i + 1 < argc) {
+      opts.derivations = strcmp(argv[i], "--count") == 0 ? options::kCount :
+                         strcmp(argv[i], "--enumerate") == 0 ? options::kEnumerate : options::kUniform;
+      opts.derivationDepth = atoi(argv[++i]);
+      if (opts.derivationDepth <= 0) return false;
+    } else if (strcmp(argv[i], "--from") == 0 && i + 1 < argc) {
+      char *end;
+      opts.firstRank = strtoull(argv[++i], &end, 0);
+      if (*end != '\0') return false;
+    } else if (strcmp(argv[i], "--unique") == 0) {
+      opts.unique = true;
+    } else if (strcmp(argv[i], "--min-words") == 0 && i + 1 < argc) {
+      opts.minWords = atoi(argv[++i]);
+      if (opts.minWords < 0) return false;
+    } else if (strcmp(argv[i], "--max-words") == 0 && i + 1 < argc) {
+      opts.maxWords = atoi(argv[++i]);
+      if (opts.maxWords <= 0 || opts.maxWords > kMaxWindowWords) return false;
+    } else if (strcmp(argv[i], "--serve") == 0 && i + 1 < argc) {
+      opts.serveSocket = argv[++i];
+    } else if (strcmp(argv[i], "--request") == 0 && i + 1 < argc) {
+      opts.requestSocket = argv[++i];
+    } else if (argv[i][0] == '-' || opts.grammarFileName != NULL) {
+      return false;
+    } else {
+      opts.grammarFileName = argv[i];
+    }
   }
+
+  if (opts.numThreads == -1)   // the daemon generates for many clients at once; everything else, for one
+    opts.numThreads = opts.serveSocket != NULL ? max(1u, thread::hardware_concurrency()) : 1;
+  if ((opts.compile || opts.emitCpp) != (opts.outputFileName != NULL)) return false;
+  if (opts.compile && opts.emitCpp) return false;
+  if (opts.derivations == options::kUniform && opts.count == 0) return false;
+  if (opts.minWords > 0 && opts.minWords > opts.maxWords) return false;
+  if (opts.unique && opts.count == 0) return false;
+  if (opts.serveSocket != NULL) return opts.grammarFileName == NULL && opts.requestSocket == NULL;
+  if (opts.requestSocket != NULL && opts.count == 0) return false;
+  return opts.grammarFileName != NULL;
+}
+
+/**
+ * Handles --count, --enumerate and --uniform, all of which work
+ * off of the Enumerator's table of derivation counts.  Returns the
+ * program's exit status.
+ */
+
+static int writeDerivations(const Grammar& grammar, int start, const options& opts)
+{
+  Enumerator enumerator(grammar, opts.derivationDepth);
+  uint64_t total = enumerator.getCount(start);
+  if (opts.derivations == options::kCount) {
+    if (total == Enumerator::kSaturated) cout << "at least ";
+    cout << total << endl;
+    return 0;
+  }
+
+  if (total == Enumerator::kSaturated) {
+    cerr << "There are too many derivations of depth " << opts.derivationDepth << " or less to number them." << endl;
+    return 4;
+  }
+
+  OutputBuffer out(STDOUT_FILENO);
+  if (opts.derivations == options::kEnumerate) {
+    uint64_t last = total;
+    if (opts.count > 0 && opts.firstRank < total && (uint64_t) opts.count < total - opts.firstRank)
+      last = opts.firstRank + opts.count;   // compared as a difference so a huge --from can't wrap
+    for (uint64_t rank = opts.firstRank; rank < last; rank++) {
+      enumerator.unrank(start, rank, out);
+      out.append('\n');
+    }
+  } else {
+    RandomGenerator random(opts.seed);
+    for (long i = 0; i < opts.count && total > 0; i++) {
+      enumerator.unrank(start, random.getRandomIndex64(total), out);
+      out.append('\n');
+    }
+  }
+
+  return 0;
+}
+
+/**
+ * Handles --max-words, which draws sentences from a LengthSampler
+ * rather than a Generator: the classic three versions, or -n sentences
+ * one per line.  Sampling is single-threaded, so -j and --unordered
+ * don't apply.  Returns the program's exit status.
+ */
+
+static int writeWindowed(const Grammar& grammar, int start, const options& opts)
+{
+  LengthSampler sampler(grammar, opts.minWords, opts.maxWords, opts.maxDepth);
+  sampler.seed(opts.seed);
+  OutputBuffer out(STDOUT_FILENO);
+  long count = opts.count > 0 ? opts.count : 3;
+  for (long i = 1; i <= count; i++) {
+    size_t mark = out.size();
+    if (opts.count == 0) {
+      char header[64];
+      out.append(string_view(header, sprintf(header, "Version #%ld: -------------\n", i)));
+    }
+    if (!sampler.generate(start, out)) {
+      out.truncate(mark);
+      out.flush();
+      cout << sampler.getError() << endl;
+      return EXIT_FAILURE;
+    }
+    out.append('\n');
+  }
+
+  return 0;
+}
+
+/**
+ * Handles --unique, drawing sentences from source (a Generator or a
+ * LengthSampler) until opts.count distinct ones have been written.
+ * Each sentence is assembled in a detached buffer first, since one
+ * attached to stdout might drain a repeat before it could be backed out.
+ * Returns the program's exit status.
+ */
+
+template <typename Source>
+static int writeUnique(Source& source, int start, const options& opts)
+{
+  source.seed(opts.seed);
+  SeenSet seen(opts.count);
+  OutputBuffer sentence;
+  OutputBuffer out(STDOUT_FILENO);
+  long generated = 0, duplicateRun = 0;
+  while ((long) seen.size() < opts.count && duplicateRun < kMaxDuplicateRun && !seen.outOfMemory()) {
+    sentence.clear();
+    if (!source.generate(start, sentence)) {
+      out.flush();
+      cerr << source.getError() << endl;
+      return EXIT_FAILURE;
+    }
+    generated++;
+
+    string_view text(sentence.data(), sentence.size());
+    if (seen.insert(text)) {
+      out.append(text);
+      out.append('\n');
+      duplicateRun = 0;
+    } else {
+      duplicateRun++;
+    }
+  }
+
+  out.flush();
+  long duplicates = generated - seen.size();
+  fprintf(stderr, "%ld unique sentences from %ld generated (%.2f%% duplicates).\n",
+          (long) seen.size(), generated, generated == 0 ? 0.0 : 100.0 * duplicates / generated);
+  if ((long) seen.size() == opts.count) return 0;
+  if (seen.outOfMemory()) {
+    cerr << "Gave up after " << seen.size() << " unique sentences; there's no memory left to remember any more." << endl;
+    return EXIT_FAILURE;
+  }
+  cerr << "Gave up after " << kMaxDuplicateRun << " duplicates in a row; the grammar seems to be out of new sentences." << endl;
+  return EXIT_FAILURE;
 }
 
 /**
@@ -61,59 +360,111 @@ static void readGrammar(ifstream& infile, map<string, Definition>& grammar)
 
 int main(int argc, char *argv[])
 {
-  if (argc == 1) {
+  options opts;
+  if (!parseOptions(argc, argv, opts)) {
     cerr << "You need to specify the name of a grammar file." << endl;
-    cerr << "Usage: rsg <path to grammar text file>" << endl;
+    cerr << "Usage: rsg [-n COUNT [-j THREADS] [--unordered] [--unique]] [--seed S] [--check] [--budget N] [--min-words N] [--max-words N] [--max-depth N] [--max-length N] <path to grammar file>" << endl;
+    cerr << "       (--max-words N takes setup time proportional to the grammar's size times N squared, and N may be at most "
+         << kMaxWindowWords << ")" << endl;
+    cerr << "       rsg --compile <path to grammar text file> -o <path to grammar image>" << endl;
+    cerr << "       rsg --emit-cpp [--budget N] [--max-depth N] [--max-length N] <path to grammar file> -o <path to C++ file>" << endl;
+    cerr << "       rsg (--count D | --enumerate D [--from K] [-n COUNT] | --uniform D -n COUNT) <path to grammar file>" << endl;
+    cerr << "       rsg --serve <path to socket> [-j THREADS] [--max-depth N] [--max-length N]" << endl;
+    cerr << "       rsg --request <path to socket> -n COUNT [--seed S] <path to grammar file>" << endl;
     return 1; // non-zero return value means something bad happened 
   }
 
-  ifstream grammarFile(argv[1]);
-  if (grammarFile.fail()) {
-    cerr << "Failed to open the file named \"" << argv[1] << "\".  Check to ensure the file exists. " << endl;
-    return 2; // each bad thing has its own bad return value
+  if (opts.serveSocket != NULL) {
+    serverOptions server = { opts.numThreads, opts.maxDepth, opts.maxLength, kMaxServedCount };
+    return serve(opts.serveSocket, server) ? 0 : 2;
+  }
+  if (opts.requestSocket != NULL)
+    return request(opts.requestSocket, opts.grammarFileName, opts.count, opts.seed) ? 0 : 2;
+
+  unique_ptr<Grammar> compiled(loadGrammar(opts.grammarFileName));
+  if (compiled == NULL) return 2; // each bad thing has its own bad return value
+  if (opts.compile) {
+    if (compiled->save(opts.outputFileName)) return 0;
+    cerr << "Failed to write the grammar image to \"" << opts.outputFileName << "\"." << endl;
+    return 3;
   }
 
   // things are looking good...
-  map<string, Definition> grammar;
-  readGrammar(grammarFile, grammar);
-  
-  for (int i = 1; i <= 3; i++) {
-    string result = "";
-    int exit_code = 1;
-    getExtensions("<start>", grammar, result, exit_code);
-    
-    if (exit_code == 1) {
-      cout << "Version #" << i << ": -------------" << endl;
-      cout << result << endl;
-    } else {
-      // in case there is an undefined nonterminal.
-      exit(EXIT_FAILURE);
-    }
+  int start = compiled->lookupNonterminal("<start>");
+  if (start == -1) {
+    cout << "Could not find \"<start>\" in the grammar file." << endl;
+    exit(EXIT_FAILURE);
   }
 
-  return 0;
-}
+  grammarReport report;
+  analyzeGrammar(*compiled, start, report);
+  string problem;
+  bool doomed = isDoomed(*compiled, start, report, problem);
+  if (opts.check) {
+    addExpectedLengths(*compiled, report);
+    printReport(*compiled, start, report, cout);
+    if (doomed) cout << problem << endl;
+    return doomed ? 1 : 0;
+  }
+  if (doomed) {
+    // reject the grammar before wasting any time generating from it
+    cout << problem << endl;
+    exit(EXIT_FAILURE);
+  }
 
+  if (opts.budget > 0) addExpectedLengths(*compiled, report);   // only the budget needs them
+  if (opts.budget > 0 && report.expectedLength[start] > opts.budget) {
+    vector<double> weights;
+    if (!biasTowardTermination(*compiled, start, opts.budget, weights))
+      cerr << "Warning: couldn't bias the grammar enough to meet a budget of " << opts.budget << " terminals." << endl;
+    compiled.reset(new Grammar(*compiled, weights));
+  }
+  const Grammar& grammar = *compiled;
 
-bool isNonTerminal(string st){
-  return (st[0] == '<' && st[st.length() - 1] == '>');
-}
+  if (opts.emitCpp) {
+    ofstream outfile(opts.outputFileName);
+    if (emitCpp(grammar, start, opts.grammarFileName, opts.maxDepth, opts.maxLength, outfile)) return 0;
+    cerr << "Failed to write the C++ program to \"" << opts.outputFileName << "\"." << endl;
+    return 3;
+  }
+  if (opts.derivations != options::kRandom) return writeDerivations(grammar, start, opts);
+  if (opts.unique && opts.maxWords > 0) {
+    LengthSampler sampler(grammar, opts.minWords, opts.maxWords, opts.maxDepth);
+    return writeUnique(sampler, start, opts);
+  }
+  if (opts.unique) {
+    Generator generator(grammar, opts.maxDepth, opts.maxLength);
+    return writeUnique(generator, start, opts);
+  }
+  if (opts.maxWords > 0) return writeWindowed(grammar, start, opts);
+
+  if (opts.count > 0) {
+    batchOptions batch = { opts.count, opts.numThreads, opts.unordered, opts.maxDepth, opts.maxLength, opts.seed };
+    string error;
+    if (!generateBatch(grammar, start, batch, error)) {
+      cerr << error << endl;
+      exit(EXIT_FAILURE);
+    }
+    return 0;
+  }
 
-/* concatenates new extensions to a string variable */
-void getExtensions(string def_id, map<string, Definition> &grammar, string &curr, int &exit_code){
-  if (grammar.find(def_id) == grammar.end()) {
-    cout << "Could not find \"" << def_id << "\" in the grammar file." << endl;
-    exit_code = 0;
-    return;
-  }
-  
-  Production cur_prod = grammar[def_id].getRandomProduction();
-  for (Production::iterator it = cur_prod.begin(); it != cur_prod.end(); it++) {
-    if (isNonTerminal(*it)) {
-      getExtensions(*it, grammar, curr, exit_code);
+  Generator generator(grammar, opts.maxDepth, opts.maxLength);
+  generator.seed(opts.seed);
+  OutputBuffer out(STDOUT_FILENO);
+  for (int i = 1; i <= 3; i++) {
+    char header[64];
+    size_t mark = out.size();
+    out.append(string_view(header, sprintf(header, "Version #%d: -------------\n", i)));
+    if (generator.generate(start, out)) {
+      out.append('\n');
     } else {
-      curr += *it;
-      curr += " ";
+      // undefined nonterminal, or a derivation that ran away
+      out.truncate(mark);
+      out.flush();
+      cout << generator.getError() << endl;
+      exit(EXIT_FAILURE);
     }
   }
+
+  return 0;
 }
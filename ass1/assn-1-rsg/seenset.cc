@@ -0,0 +1,107 @@
+/**
+ * File: seenset.cc
+ * ----------------
+ * Provides the implementation of the SeenSet class.  The table is
+ * kept at most half full, so probes stay short, and since the
+ * fingerprints are already uniformly distributed their low bits serve
+ * directly as the starting slot.
+ */
+
+#include "seenset.h"
+#include <algorithm>
+#include <new>
+#include <string.h>
+
+static const size_t kMinSlots = 1024;
+static const size_t kMaxInitialSentences = 1 << 20;   // 16MB of slots
+
+SeenSet::SeenSet(size_t expected) : count(0), exhausted(false)
+{
+  size_t numSlots = kMinSlots;
+  while (numSlots < 2 * min(expected, kMaxInitialSentences)) numSlots *= 2;
+  slots.resize(numSlots, 0);
+}
+
+/**
+ * Function: mix
+ * -------------
+ * The 64-bit finalizer from MurmurHash3, which spreads every input
+ * bit across every output bit.
+ */
+
+static uint64_t mix(uint64_t h)
+{
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  return h ^ (h >> 33);
+}
+
+/**
+ * Static Method: fingerprint
+ * --------------------------
+ * Folds the text in eight bytes at a time, with a multiply and a
+ * rotate per word, and finishes with mix.  The length is folded in
+ * first, so texts that differ only in trailing zero bytes still differ.
+ */
+
+uint64_t SeenSet::fingerprint(string_view text)
+{
+  uint64_t h = 0x9E3779B97F4A7C15ULL ^ (text.size() * 0xff51afd7ed558ccdULL);
+  size_t i = 0;
+  for (; i + 8 <= text.size(); i += 8) {
+    uint64_t word;
+    memcpy(&word, text.data() + i, 8);
+    h = (h ^ mix(word)) * 0x9E3779B97F4A7C15ULL;
+    h = (h << 27) | (h >> 37);
+  }
+  if (i < text.size()) {
+    uint64_t word = 0;
+    memcpy(&word, text.data() + i, text.size() - i);
+    h = (h ^ mix(word)) * 0x9E3779B97F4A7C15ULL;
+  }
+
+  h = mix(h);
+  return h == 0 ? 1 : h;
+}
+
+bool SeenSet::insert(string_view sentence)
+{
+  uint64_t key = fingerprint(sentence);
+  size_t mask = slots.size() - 1;
+  for (size_t i = key & mask; ; i = (i + 1) & mask) {
+    if (slots[i] == key) return false;
+    if (slots[i] == 0) {
+      slots[i] = key;
+      if (++count * 2 > slots.size() && !exhausted) exhausted = !grow();
+      return true;
+    }
+  }
+}
+
+/**
+ * Method: grow
+ * ------------
+ * Doubles the table and reinserts every fingerprint.  Returns false,
+ * leaving the table as it was, if the bigger one can't be allocated.
+ */
+
+bool SeenSet::grow()
+{
+  vector<uint64_t> old;
+  try {
+    old.assign(slots.size() * 2, 0);
+  } catch (const bad_alloc&) {
+    return false;
+  }
+  old.swap(slots);
+  size_t mask = slots.size() - 1;
+  for (size_t j = 0; j < old.size(); j++) {
+    if (old[j] == 0) continue;
+    size_t i = old[j] & mask;
+    while (slots[i] != 0) i = (i + 1) & mask;
+    slots[i] = old[j];
+  }
+  return true;
+}
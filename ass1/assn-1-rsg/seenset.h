@@ -0,0 +1,84 @@
+#ifndef __seenset__
+#define __seenset__
+
+/**
+ * File: seenset.h
+ * ---------------
+ * Defines the SeenSet class, which remembers which sentences have
+ * already been written so that rsg --unique can skip repeats without
+ * holding on to the sentences themselves.  Each sentence is reduced to
+ * a 64-bit fingerprint, and the fingerprints are kept in a flat open
+ * addressing table with linear probing, at eight bytes a slot.
+ *
+ * Two different sentences sharing a fingerprint would make the second
+ * look like a repeat, but among a billion sentences the odds of that
+ * happening even once are about one in forty.
+ */
+
+#include <string_view>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+using namespace std;
+
+class SeenSet {
+
+ public:
+
+  /**
+   * Constructor: SeenSet
+   * --------------------
+   * Constructs an empty set sized to hold the specified number
+   * of sentences without growing, up to kMaxInitialSentences; past
+   * that the table grows as it fills, so a COUNT far beyond what the
+   * grammar can produce costs nothing up front.
+   */
+
+  SeenSet(size_t expected = 0);
+
+  /**
+   * Method: insert
+   * --------------
+   * Adds the specified sentence to the set, returning true if it
+   * wasn't there before and false if it was.  If the table needs to
+   * grow and there isn't memory for it, the sentence is still added,
+   * but outOfMemory returns true from then on.
+   */
+
+  bool insert(string_view sentence);
+
+  /**
+   * Method: size
+   * ------------
+   * Returns the number of distinct sentences inserted so far.
+   */
+
+  size_t size() const { return count; }
+
+  /**
+   * Method: outOfMemory
+   * -------------------
+   * Returns true if the table has failed to grow, after which it
+   * shouldn't be asked to hold any more sentences.
+   */
+
+  bool outOfMemory() const { return exhausted; }
+
+  /**
+   * Static Method: fingerprint
+   * --------------------------
+   * Hashes the specified bytes down to 64 bits.  Never returns 0,
+   * which the table uses to mark empty slots.
+   */
+
+  static uint64_t fingerprint(string_view text);
+
+ private:
+  vector<uint64_t> slots;    // 0 marks an empty slot; the size is always a power of two
+  size_t count;
+  bool exhausted;
+
+  bool grow();
+};
+
+#endif // ! __seenset__
@@ -0,0 +1,586 @@
+/**
+ * File: server.cc
+ * ---------------
+ * Provides the implementation of rsg's daemon mode and its client.
+ * Compiled grammars live in a cache keyed by canonical path, each
+ * one held by a shared_ptr.  A request copies the shared_ptr out of
+ * the cache (holding the lock only that long) and generates with no
+ * lock at all, so a reload, which builds the new Grammar off to the
+ * side and then swaps the pointer, never waits on a request and never
+ * pulls a Grammar out from under one: the old version is freed when
+ * the last request using it lets go.
+ *
+ * The directory of every cached grammar is watched with inotify,
+ * rather than the file itself, so that editors and rsg --compile,
+ * which replace files by renaming over them, are noticed too.  The
+ * cache holds at most kMaxCachedGrammars grammars, evicting the one
+ * used least recently to make room, and a directory stops being watched
+ * once no grammar in the cache comes from it.
+ *
+ * Each connection gets a thread of its own, which does nothing but read
+ * requests and hand them to a fixed pool of generation threads, so an
+ * idle client ties up nothing more than that one cheap thread, and only
+ * until it has been quiet for kIdleSeconds.
+ */
+
+#include "server.h"
+#include "analysis.h"
+#include "batch.h"
+#include "generator.h"
+#include "loader.h"
+#include "output.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <errno.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+static const size_t kMaxRequestLength = PATH_MAX + 64;
+static const size_t kMaxCachedGrammars = 64;
+static const int kMaxConnections = 1024;
+static const int kIdleSeconds = 60;
+
+/**
+ * Struct: residentGrammar
+ * -----------------------
+ * A compiled grammar along with the results of checking it, which are
+ * worked out once per load rather than once per request.  If the grammar
+ * can't be used, grammar may be NULL, and error says why.
+ */
+
+struct residentGrammar {
+  unique_ptr<Grammar> grammar;
+  int start;
+  string error;
+};
+
+/**
+ * Struct: cachedGrammar
+ * ---------------------
+ * A cache entry: the resident grammar, and when it was last asked for
+ * (in ticks of serverState::clock), for picking what to evict.
+ */
+
+struct cachedGrammar {
+  shared_ptr<const residentGrammar> resident;
+  uint64_t lastUsed;
+};
+
+/**
+ * Struct: pendingLoad
+ * -------------------
+ * Stands in for a grammar that isn't cached yet but is being loaded
+ * by one or more threads.  The reloader counts every change to the file in
+ * changes, so a loader can tell whether the file changed under it.
+ */
+
+struct pendingLoad {
+  int loaders;
+  uint64_t changes;
+};
+
+/**
+ * Struct: job
+ * -----------
+ * One request, handed from the thread reading its connection to a
+ * generation thread, which sets delivered (false if the client has
+ * gone away) and then done.
+ */
+
+struct job {
+  int client;
+  const string *line;
+  bool delivered;
+  bool done;
+};
+
+/**
+ * Struct: serverState
+ * -------------------
+ * Everything the connection threads, the generation threads and the
+ * reloader share.  The cache, the loads underway and the watch table are
+ * guarded by lock, and the queue of jobs by jobLock.
+ */
+
+struct serverState {
+  const serverOptions *opts;
+  int listener;
+  int notifier;
+
+  mutex lock;
+  map<string, cachedGrammar> cache;                 // keyed by canonical path
+  map<string, pendingLoad> loading;                 // likewise
+  map<int, string> watchedDirectories;              // inotify watch descriptor -> directory
+  uint64_t clock;                                   // ticks once per lookup
+
+  mutex jobLock;
+  condition_variable jobQueued;
+  condition_variable jobDone;
+  deque<job *> jobs;
+  atomic<int> numConnections;
+};
+
+/**
+ * Function: loadResident
+ * ----------------------
+ * Loads and checks the grammar at the specified path exactly as rsg
+ * itself does before generating from it.  Error messages are flattened
+ * onto one line, since that's all an ERROR reply has room for.
+ */
+
+static shared_ptr<const residentGrammar> loadResident(const string& path)
+{
+  residentGrammar *resident = new residentGrammar;
+  resident->grammar.reset(loadGrammar(path.c_str(), resident->error));
+  resident->start = -1;
+  if (resident->grammar != NULL) {
+    resident->start = resident->grammar->lookupNonterminal("<start>");
+    if (resident->start == -1) {
+      resident->error = "Could not find \"<start>\" in the grammar file.";
+    } else {
+      grammarReport report;
+      analyzeGrammar(*resident->grammar, resident->start, report);
+      isDoomed(*resident->grammar, resident->start, report, resident->error);
+    }
+  }
+
+  for (size_t i = 0; i < resident->error.size(); i++)
+    if (resident->error[i] == '\n') resident->error[i] = ' ';
+  return shared_ptr<const residentGrammar>(resident);
+}
+
+/**
+ * Function: getDirectory
+ * ----------------------
+ * Returns the directory holding the file at the specified canonical path.
+ */
+
+static string getDirectory(const string& path)
+{
+  string directory = path.substr(0, path.rfind('/'));
+  return directory.empty() ? "/" : directory;
+}
+
+/**
+ * Function: releaseDirectory
+ * --------------------------
+ * Stops watching the specified directory, unless some grammar that's
+ * cached or being loaded still lives there.  The caller must hold the
+ * lock.
+ */
+
+static void releaseDirectory(serverState& state, const string& directory)
+{
+  for (auto curr = state.cache.begin(); curr != state.cache.end(); ++curr)
+    if (getDirectory(curr->first) == directory) return;
+  for (auto curr = state.loading.begin(); curr != state.loading.end(); ++curr)
+    if (getDirectory(curr->first) == directory) return;
+
+  for (auto curr = state.watchedDirectories.begin(); curr != state.watchedDirectories.end(); ++curr) {
+    if (curr->second != directory) continue;
+    inotify_rm_watch(state.notifier, curr->first);
+    state.watchedDirectories.erase(curr);
+    return;
+  }
+}
+
+/**
+ * Function: cacheResident
+ * -----------------------
+ * Adds the specified grammar to the cache, unless another thread got
+ * there first, evicting the least recently used entry if the cache is
+ * full.  Returns whichever version ends up cached.  The caller must hold
+ * the lock.
+ */
+
+static shared_ptr<const residentGrammar> cacheResident(serverState& state, const string& path,
+                                                       const shared_ptr<const residentGrammar>& resident)
+{
+  cachedGrammar entry = { resident, state.clock };
+  auto inserted = state.cache.insert(make_pair(path, entry));
+  if (inserted.second && state.cache.size() > kMaxCachedGrammars) {
+    auto oldest = state.cache.begin();
+    for (auto curr = state.cache.begin(); curr != state.cache.end(); ++curr)
+      if (curr->second.lastUsed < oldest->second.lastUsed) oldest = curr;
+    string directory = getDirectory(oldest->first);
+    state.cache.erase(oldest);   // never the new entry, which was used just now
+    releaseDirectory(state, directory);
+  }
+  return inserted.first->second.resident;
+}
+
+/**
+ * Function: lookupResident
+ * ------------------------
+ * Returns the resident version of the named grammar, loading it (and
+ * watching its directory) the first time it's asked for.  The watch is
+ * set up, and the load registered in state.loading, before the file is
+ * read, so the reloader counts any change made while it's being loaded;
+ * if there was one, the file is simply loaded again.  Two threads may
+ * race to load the same grammar; the first one in wins.
+ */
+
+static shared_ptr<const residentGrammar> lookupResident(serverState& state, const string& fileName)
+{
+  char resolved[PATH_MAX];
+  if (realpath(fileName.c_str(), resolved) == NULL)
+    return loadResident(fileName);    // can't exist, so let loadGrammar explain
+  string path = resolved;
+
+  uint64_t changes;
+  {
+    lock_guard<mutex> guard(state.lock);
+    state.clock++;
+    auto found = state.cache.find(path);
+    if (found != state.cache.end()) {
+      found->second.lastUsed = state.clock;
+      return found->second.resident;
+    }
+    string directory = getDirectory(path);
+    int wd = inotify_add_watch(state.notifier, directory.c_str(),
+                               IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE);
+    if (wd != -1) state.watchedDirectories[wd] = directory;
+    pendingLoad& pending = state.loading[path];   // starts out zeroed
+    pending.loaders++;
+    changes = pending.changes;
+  }
+
+  while (true) {
+    shared_ptr<const residentGrammar> resident = loadResident(path);
+    lock_guard<mutex> guard(state.lock);
+    pendingLoad& pending = state.loading[path];
+    if (pending.changes != changes) {
+      changes = pending.changes;      // changed while we were reading it
+      continue;
+    }
+    if (--pending.loaders == 0) state.loading.erase(path);
+    return cacheResident(state, path, resident);
+  }
+}
+
+/**
+ * Function: reloader
+ * ------------------
+ * Thread routine: waits on inotify and, whenever a cached grammar's
+ * file is rewritten or replaced, loads the new version and swaps it
+ * into the cache.  A grammar whose file goes away is simply dropped,
+ * so the next request for it reports the problem.  Changes to a file
+ * that's still being loaded for the first time are counted, so that
+ * lookupResident knows to load it again.
+ */
+
+static void reloader(serverState *state)
+{
+  alignas(struct inotify_event) char events[4096];
+  while (true) {
+    ssize_t length = read(state->notifier, events, sizeof(events));
+    if (length <= 0) {
+      if (length == -1 && errno == EINTR) continue;
+      return;
+    }
+
+    for (char *p = events; p < events + length; p += sizeof(struct inotify_event) + ((struct inotify_event *) p)->len) {
+      const struct inotify_event *event = (const struct inotify_event *) p;
+      if (event->len == 0) continue;
+      string path;
+      {
+        lock_guard<mutex> guard(state->lock);
+        auto directory = state->watchedDirectories.find(event->wd);
+        if (directory == state->watchedDirectories.end()) continue;
+        path = directory->second == "/" ? "/" : directory->second + "/";
+        path += event->name;
+        auto pending = state->loading.find(path);
+        if (pending != state->loading.end()) pending->second.changes++;
+        auto found = state->cache.find(path);
+        if (found == state->cache.end()) continue;
+        if (event->mask & (IN_MOVED_FROM | IN_DELETE)) {
+          state->cache.erase(found);
+          releaseDirectory(*state, directory->second);
+          continue;
+        }
+      }
+
+      shared_ptr<const residentGrammar> resident = loadResident(path);   // no lock held
+      lock_guard<mutex> guard(state->lock);
+      auto found = state->cache.find(path);
+      if (found != state->cache.end()) found->second.resident = resident;   // unless evicted meanwhile
+    }
+  }
+}
+
+/**
+ * Function: writeFully
+ * --------------------
+ * Writes all length bytes to fd, returning false if that can't be done.
+ */
+
+static bool writeFully(int fd, const char *data, size_t length)
+{
+  while (length > 0) {
+    ssize_t written = write(fd, data, length);
+    if (written == -1 && errno == EINTR) continue;
+    if (written <= 0) return false;
+    data += written;
+    length -= written;
+  }
+
+  return true;
+}
+
+/**
+ * Function: readLine
+ * ------------------
+ * Reads from fd until pending holds a complete line, which is then moved
+ * (minus its newline) into line.  Whatever follows the line stays in
+ * pending for next time.  Returns false at end of file, on an error, or
+ * if the line grows longer than any legitimate request.
+ */
+
+static bool readLine(int fd, string& pending, string& line)
+{
+  while (true) {
+    size_t newline = pending.find('\n');
+    if (newline != string::npos) {
+      line.assign(pending, 0, newline);
+      pending.erase(0, newline + 1);
+      return true;
+    }
+    if (pending.size() > kMaxRequestLength) return false;
+
+    char chunk[4096];
+    ssize_t length = read(fd, chunk, sizeof(chunk));
+    if (length == -1 && errno == EINTR) continue;
+    if (length <= 0) return false;
+    pending.append(chunk, length);
+  }
+}
+
+/**
+ * Function: sendLine
+ * ------------------
+ * Writes prefix, then text, then a newline to the client, returning
+ * false if the client has gone away.
+ */
+
+static bool sendLine(int client, OutputBuffer& line, const char *prefix, const string& text)
+{
+  line.clear();
+  line.append(prefix);
+  line.append(text);
+  line.append('\n');
+  const OutputBuffer *reply[] = { &line };
+  return writeBuffers(client, reply, 1);
+}
+
+/**
+ * Function: answer
+ * ----------------
+ * Carries out the request spelled out in line, sending the reply to the
+ * client one chunk of kSentencesPerChunk sentences at a time, so that no
+ * more than one chunk is ever held in memory.  Returns false if the
+ * client has gone away.
+ */
+
+static bool answer(serverState& state, int client, const string& line, OutputBuffer& header, OutputBuffer& body)
+{
+  long count;
+  unsigned long long seed;
+  int fileNameStart = 0;
+  if (sscanf(line.c_str(), "%ld %llu %n", &count, &seed, &fileNameStart) != 2 ||
+      fileNameStart == 0 || fileNameStart == (int) line.size())
+    return sendLine(client, header, "ERROR ", "Malformed request; expected COUNT SEED GRAMMAR-FILE.");
+  if (count <= 0 || count > state.opts->maxCount)
+    return sendLine(client, header, "ERROR ", "COUNT must be between 1 and " + to_string(state.opts->maxCount) + ".");
+
+  shared_ptr<const residentGrammar> resident = lookupResident(state, line.substr(fileNameStart));
+  if (!resident->error.empty()) return sendLine(client, header, "ERROR ", resident->error);
+
+  Generator generator(*resident->grammar, state.opts->maxDepth, state.opts->maxLength);
+  for (long first = 0; first < count; first += kSentencesPerChunk) {
+    body.clear();
+    if (!generateSentences(generator, resident->start, seed, first, min(count, first + kSentencesPerChunk), body))
+      return sendLine(client, header, "ERROR ", generator.getError());
+    header.clear();
+    header.append("DATA ");
+    header.append(to_string(body.size()));
+    header.append('\n');
+    const OutputBuffer *reply[] = { &header, &body };
+    if (!writeBuffers(client, reply, 2)) return false;
+  }
+
+  return sendLine(client, header, "END", "");
+}
+
+/**
+ * Function: generationWorker
+ * --------------------------
+ * Thread routine: takes jobs off the queue one after another and
+ * answers them.  Every worker keeps its own buffers, so their capacity
+ * carries over from request to request.
+ */
+
+static void generationWorker(serverState *state)
+{
+  OutputBuffer header;
+  OutputBuffer body;
+  while (true) {
+    job *request;
+    {
+      unique_lock<mutex> guard(state->jobLock);
+      state->jobQueued.wait(guard, [state] { return !state->jobs.empty(); });
+      request = state->jobs.front();
+      state->jobs.pop_front();
+    }
+
+    bool delivered = answer(*state, request->client, *request->line, header, body);
+    lock_guard<mutex> guard(state->jobLock);
+    request->delivered = delivered;
+    request->done = true;
+    state->jobDone.notify_all();
+  }
+}
+
+/**
+ * Function: connectionReader
+ * --------------------------
+ * Thread routine: reads the requests on one connection, queues each one
+ * for the generation threads, and waits for it to be answered before
+ * reading the next.  A client that sends nothing, or reads nothing, for
+ * kIdleSeconds is hung up on.
+ */
+
+static void connectionReader(serverState *state, int client)
+{
+  struct timeval timeout = { kIdleSeconds, 0 };
+  setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+  setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+  string pending, line;
+  while (readLine(client, pending, line)) {
+    job request = { client, &line, false, false };
+    unique_lock<mutex> guard(state->jobLock);
+    state->jobs.push_back(&request);
+    state->jobQueued.notify_one();
+    state->jobDone.wait(guard, [&request] { return request.done; });
+    if (!request.delivered) break;
+  }
+
+  close(client);
+  state->numConnections--;
+}
+
+/**
+ * Function: openSocket
+ * --------------------
+ * Fills in addr for the specified socket path and returns a new
+ * Unix domain socket, or -1 if that can't be done.
+ */
+
+static int openSocket(const char *socketPath, struct sockaddr_un& addr)
+{
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (strlen(socketPath) >= sizeof(addr.sun_path)) {
+    errno = ENAMETOOLONG;
+    return -1;
+  }
+  strcpy(addr.sun_path, socketPath);
+  return socket(AF_UNIX, SOCK_STREAM, 0);
+}
+
+bool serve(const char *socketPath, const serverOptions& opts)
+{
+  signal(SIGPIPE, SIG_IGN);   // a client hanging up mid-reply mustn't take the daemon down
+
+  serverState state;
+  state.opts = &opts;
+  state.clock = 0;
+  struct sockaddr_un addr;
+  state.listener = openSocket(socketPath, addr);
+  if (state.listener != -1) unlink(socketPath);
+  if (state.listener == -1 || bind(state.listener, (struct sockaddr *) &addr, sizeof(addr)) == -1 ||
+      listen(state.listener, SOMAXCONN) == -1) {
+    cerr << "Failed to listen on \"" << socketPath << "\": " << strerror(errno) << endl;
+    return false;
+  }
+
+  state.notifier = inotify_init1(IN_CLOEXEC);
+  if (state.notifier == -1) {
+    cerr << "Failed to set up inotify: " << strerror(errno) << endl;
+    return false;
+  }
+
+  thread(reloader, &state).detach();
+  for (int i = 0; i < opts.numThreads; i++)
+    thread(generationWorker, &state).detach();
+
+  OutputBuffer refusal;
+  state.numConnections = 0;
+  while (true) {
+    int client = accept4(state.listener, NULL, NULL, SOCK_CLOEXEC);
+    if (client == -1) continue;
+    if (state.numConnections >= kMaxConnections) {
+      sendLine(client, refusal, "ERROR ", "The rsg daemon is serving too many connections; try again later.");
+      close(client);
+      continue;
+    }
+    state.numConnections++;
+    thread(connectionReader, &state, client).detach();
+  }
+}
+
+bool request(const char *socketPath, const char *grammarFileName, long count, uint64_t seed)
+{
+  // the daemon resolves relative names against its own directory, not ours
+  char resolved[PATH_MAX];
+  if (realpath(grammarFileName, resolved) != NULL) grammarFileName = resolved;
+
+  struct sockaddr_un addr;
+  int server = openSocket(socketPath, addr);
+  if (server == -1 || connect(server, (struct sockaddr *) &addr, sizeof(addr)) == -1) {
+    cerr << "Failed to connect to the rsg daemon at \"" << socketPath << "\": " << strerror(errno) << endl;
+    if (server != -1) close(server);
+    return false;
+  }
+
+  string line = to_string(count) + " " + to_string(seed) + " " + grammarFileName + "\n";
+  string pending, header;
+  if (!writeFully(server, line.data(), line.size())) header = "Lost the connection to the rsg daemon.";
+  char chunk[1 << 16];
+  while (header.empty() && readLine(server, pending, header) && header.compare(0, 5, "DATA ") == 0) {
+    long remaining = atol(header.c_str() + 5);
+    long buffered = min(remaining, (long) pending.size());
+    bool copied = writeFully(STDOUT_FILENO, pending.data(), buffered);
+    pending.erase(0, buffered);
+    remaining -= buffered;
+    while (copied && remaining > 0) {
+      ssize_t length = read(server, chunk, min((long) sizeof(chunk), remaining));
+      if (length == -1 && errno == EINTR) continue;
+      copied = length > 0 && writeFully(STDOUT_FILENO, chunk, length);
+      remaining -= length;
+    }
+    header.clear();
+    if (!copied) header = "Lost the connection to the rsg daemon.";
+  }
+
+  bool succeeded = header == "END";
+  if (header.empty()) header = "Lost the connection to the rsg daemon.";
+  if (!succeeded) cerr << (header.compare(0, 6, "ERROR ") == 0 ? header.substr(6) : header) << endl;
+  close(server);
+  return succeeded;
+}
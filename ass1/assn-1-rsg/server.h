@@ -0,0 +1,78 @@
+#ifndef __server__
+#define __server__
+
+/**
+ * File: server.h
+ * --------------
+ * Defines rsg's daemon mode, which listens on a Unix domain socket
+ * and generates sentences on request out of grammars it keeps compiled
+ * in memory, so that clients pay for parsing a grammar once rather than
+ * on every invocation.  Each request is a single line
+ *
+ *     COUNT SEED GRAMMAR-FILE
+ *
+ * (the file name runs to the end of the line, and relative names are
+ * resolved against the daemon's working directory), and is answered with
+ * any number of chunks, each one a line
+ *
+ *     DATA BYTES
+ *
+ * followed by exactly BYTES bytes, which together hold COUNT sentences,
+ * one per line and identical to those rsg -n COUNT --seed SEED GRAMMAR-FILE
+ * writes, and then a single line
+ *
+ *     END
+ *
+ * A request that can't be carried out is answered instead with a line
+ *
+ *     ERROR MESSAGE
+ *
+ * which may come after some chunks, if a sentence fails partway through:
+ * the chunks already sent are the ones rsg -n writes before it fails.
+ *
+ * A connection may carry any number of requests, one after another,
+ * and is closed once it has been idle for a minute.
+ * Grammar files are watched with inotify, and a file that changes is
+ * reloaded and swapped in without disturbing requests already underway.
+ */
+
+#include <stdint.h>
+using namespace std;
+
+/**
+ * Struct: serverOptions
+ * ---------------------
+ * Bundles the parameters of the daemon.
+ */
+
+struct serverOptions {
+  int numThreads;      // number of requests generated at once
+  int maxDepth;        // passed along to each Generator
+  long maxLength;      // passed along to each Generator
+  long maxCount;       // largest COUNT a single request may ask for
+};
+
+/**
+ * Function: serve
+ * ---------------
+ * Binds the specified socket path (replacing any stale socket left
+ * there) and serves requests until the process is killed.  Returns
+ * false, after printing an error message, only if the daemon can't
+ * get started.
+ */
+
+bool serve(const char *socketPath, const serverOptions& opts);
+
+/**
+ * Function: request
+ * -----------------
+ * The client side: connects to the daemon at socketPath, asks for count
+ * sentences from the named grammar, and copies the reply to stdout
+ * chunk by chunk as it arrives.
+ * The grammar's name is resolved here before it's sent along.
+ * Returns false, after printing an error message, if anything goes wrong.
+ */
+
+bool request(const char *socketPath, const char *grammarFileName, long count, uint64_t seed);
+
+#endif // ! __server__
@@ -0,0 +1,78 @@
+#include "graph.h"
+#include <algorithm>
+using namespace std;
+
+/**
+ * Function: buildIdMap
+ * --------------------
+ * Pairs every record offset in the specified offset array with its
+ * position in that array (its id), sorted by offset, so that the
+ * offsets stored inside other records can be translated into ids.
+ */
+
+static void buildIdMap(const int *offsets, int count, vector<pair<int, int> >& ids)
+{
+  ids.resize(count);
+  for (int i = 0; i < count; i++) ids[i] = make_pair(offsets[i], i);
+  sort(ids.begin(), ids.end());
+}
+
+static int translate(const vector<pair<int, int> >& ids, int offset)
+{
+  return lower_bound(ids.begin(), ids.end(), make_pair(offset, 0))->second;
+}
+
+/**
+ * Method: buildAdjacency
+ * ----------------------
+ * Fills start and targets with the CSR form of one side of the graph:
+ * record i of file lists the offsets (in the other file) of its
+ * neighbors, and those are translated to ids via otherIds.
+ */
+
+void graph::buildAdjacency(const void *file, int numExtraBytes, const vector<pair<int, int> >& otherIds,
+                           vector<int>& start, vector<int>& targets)
+{
+  int count = *(const int *) file;
+  const int *offsets = (const int *) file + 1;
+  start.resize(count + 1);
+  start[0] = 0;
+  for (int i = 0; i < count; i++) {
+    int numNeighbors;
+    const int *neighbors = imdb::getRecordOffsets(file, offsets[i], numExtraBytes, numNeighbors);
+    for (int j = 0; j < numNeighbors; j++)
+      targets.push_back(translate(otherIds, neighbors[j]));
+    start[i + 1] = targets.size();
+  }
+}
+
+graph::graph(const imdb& db) : db(db)
+{
+  vector<pair<int, int> > actorIds, movieIds;
+  buildIdMap((const int *) db.actorFile + 1, *(const int *) db.actorFile, actorIds);
+  buildIdMap((const int *) db.movieFile + 1, *(const int *) db.movieFile, movieIds);
+  buildAdjacency(db.actorFile, 0, movieIds, actorCreditsStart, actorCredits);
+  buildAdjacency(db.movieFile, 1, actorIds, movieCastStart, movieCast);
+}
+
+int graph::lookupActor(const string& player) const
+{
+  const int *slot = db.findActor(player);
+  return slot == NULL ? -1 : slot - ((const int *) db.actorFile + 1);
+}
+
+int graph::lookupMovie(const film& movie) const
+{
+  const int *slot = db.findMovie(movie.title, movie.year);
+  return slot == NULL ? -1 : slot - ((const int *) db.movieFile + 1);
+}
+
+string graph::getActor(int actor) const
+{
+  return (const char *) db.actorFile + ((const int *) db.actorFile)[actor + 1];
+}
+
+film graph::getMovie(int movie) const
+{
+  return imdb::getMovieRecord(db.movieFile, ((const int *) db.movieFile)[movie + 1]);
+}
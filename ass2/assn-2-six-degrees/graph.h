@@ -0,0 +1,94 @@
+#ifndef __graph__
+#define __graph__
+
+#include "imdb.h"
+#include <string>
+#include <vector>
+using namespace std;
+
+/**
+ * Class: graph
+ * ------------
+ * The bipartite actor/movie graph stored in an imdb, rebuilt once
+ * into compressed sparse row form so that searches can walk it as
+ * plain integer arrays, with no name lookups, strlens or string copies
+ * along the way.  Every actor and every movie is identified by a dense
+ * id: its position in the imdb's sorted offset array.  The ids of the
+ * movies actor a appeared in are stored contiguously, between
+ * creditsBegin(a) and creditsEnd(a), and likewise for the cast of a
+ * movie.
+ */
+
+class graph {
+
+ public:
+
+  /**
+   * Constructor: graph
+   * ------------------
+   * Builds the adjacency arrays from the specified imdb, which must
+   * be good and must outlive the graph.  This touches every record
+   * once, so it's meant to be done once at startup.
+   */
+
+  graph(const imdb& db);
+
+  /**
+   * Methods: getNumActors, getNumMovies
+   * -----------------------------------
+   * Return the number of actors and movies, which are numbered
+   * from 0 up to (but not including) these counts.
+   */
+
+  int getNumActors() const { return actorCreditsStart.size() - 1; }
+  int getNumMovies() const { return movieCastStart.size() - 1; }
+
+  /**
+   * Methods: lookupActor, lookupMovie
+   * ---------------------------------
+   * Return the id of the named actor or of the specified movie,
+   * or -1 if the imdb doesn't know about it.
+   */
+
+  int lookupActor(const string& player) const;
+  int lookupMovie(const film& movie) const;
+
+  /**
+   * Methods: getActor, getMovie
+   * ---------------------------
+   * Return the name of an actor, or the title and year of a movie,
+   * given its id.  Used to turn search results back into a path.
+   */
+
+  string getActor(int actor) const;
+  film getMovie(int movie) const;
+
+  /**
+   * Adjacency accessors
+   * -------------------
+   * The movie ids of actor's credits live in [creditsBegin(actor),
+   * creditsEnd(actor)), and the actor ids of movie's cast live in
+   * [castBegin(movie), castEnd(movie)).
+   */
+
+  const int *creditsBegin(int actor) const { return actorCredits.data() + actorCreditsStart[actor]; }
+  const int *creditsEnd(int actor) const { return actorCredits.data() + actorCreditsStart[actor + 1]; }
+  const int *castBegin(int movie) const { return movieCast.data() + movieCastStart[movie]; }
+  const int *castEnd(int movie) const { return movieCast.data() + movieCastStart[movie + 1]; }
+
+ private:
+  const imdb& db;
+  vector<int> actorCreditsStart;   // actor id -> index into actorCredits, plus a sentinel
+  vector<int> actorCredits;
+  vector<int> movieCastStart;      // movie id -> index into movieCast, plus a sentinel
+  vector<int> movieCast;
+
+  static void buildAdjacency(const void *file, int numExtraBytes, const vector<pair<int, int> >& otherIds,
+                             vector<int>& start, vector<int>& targets);
+
+  // copying would be legal but expensive, and nobody needs it
+  graph(const graph& original);
+  graph& operator=(const graph& rhs);
+};
+
+#endif
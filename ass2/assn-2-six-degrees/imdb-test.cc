@@ -2,8 +2,8 @@
 #include <iostream>
 #include <iomanip> // for setw formatter
 #include <map>
-#include <set>
 #include <string>
+#include <string_view>
 #include "imdb.h"
 using namespace std;
 
@@ -48,22 +48,22 @@ static void printFill()
  *                credits.
  */
 
-static void listMovies(const string& player, const vector<film>& credits)
+static void listMovies(const string& player, const filmRange& credits)
 {
   const unsigned int kNumFilmsToPrint = 10;
   cout << player << " has starred in " << (int) (credits.size()) << " films." << endl;
   cout << "These films are:" << endl;
   unsigned int numMovies = 0;
-  vector<film>::const_iterator curr;
-  for (curr = credits.begin(); curr != credits.end() && numMovies < kNumFilmsToPrint; ++curr) {
-    const film& movie = *curr;
+  filmRange::iterator curr = credits.begin();
+  for (; curr != credits.end() && numMovies < kNumFilmsToPrint; ++curr) {
+    filmView movie = *curr;
     cout << setw(5) << ++numMovies << ".) " << movie.title << " (" << movie.year << ")" << endl;
   }
   if (curr != credits.end()) {
     if (credits.size() > 2 * kNumFilmsToPrint) printFill();
     while (numMovies < (credits.size() - kNumFilmsToPrint)) { numMovies++; ++curr; }
     for (;curr != credits.end(); ++curr) {
-      const film& movie = *curr;
+      filmView movie = *curr;
       cout << setw(5) << ++numMovies << ".) " << movie.title << " (" << movie.year << ")" << endl;      
     }
   }
@@ -76,8 +76,11 @@ static void listMovies(const string& player, const vector<film>& credits)
  * ---------------------
  * Builds up the list of costars and then prints all these
  * costars in a format similar to that used by listMovies.
- * The STL set is used to collect actor/actress names without
- * storing duplicates.
+ * The costars are collected in an STL map, keyed by name (string_views
+ * into the imdb's data, so no strings are copied) and sorted the same
+ * way.  Each entry holds the index of the last credit the costar turned
+ * up in and the number of different credits they've turned up in, so a
+ * costar listed twice in one cast is only counted once for that film.
  *
  * @param player the actor/actress of interest.
  * @param credits the list of movies that the specified actor/actress has appeared in.
@@ -88,17 +91,19 @@ static void listMovies(const string& player, const vector<film>& credits)
  *           set of costars.
  */
 
-static void listCostars(const string &player, const vector<film>& credits, const imdb& db)
+static void listCostars(const string &player, const filmRange& credits, const imdb& db)
 {
   const unsigned int kNumCostarsToPrint = 10;
-  map<string, set<film> > costars;
+  map<string_view, pair<int, int> > costars;   // costar -> (last credit counted, number of films)
+  playerRange cast;
   for (int i = 0; i < (int) credits.size(); i++) {
-    const film& movie = credits[i];
-    vector<string> cast;
-    db.getCast(movie, cast);
-    for (int j = 0; j < (int) cast.size(); j++) {
-      const string& costar = cast[j];
-      if (costar != player) costars[costar].insert(movie);
+    db.getCast(credits[i], cast);
+    for (playerRange::iterator curr = cast.begin(); curr != cast.end(); ++curr) {
+      string_view costar = *curr;
+      if (costar == player) continue;
+      pair<int, int>& entry = costars.emplace(costar, make_pair(-1, 0)).first->second;
+      if (entry.first != i) entry.second++;
+      entry.first = i;
     }
   }
   
@@ -106,11 +111,11 @@ static void listCostars(const string &player, const vector<film>& credits, const
   cout << "Those other people are:" << endl;
   
   unsigned int numCostars = 0;
-  map<string, set<film> >::const_iterator curr;
+  map<string_view, pair<int, int> >::const_iterator curr;
   for (curr = costars.begin(); curr != costars.end() && numCostars < kNumCostarsToPrint; ++curr) {
-    const string& costar = curr->first;
+    string_view costar = curr->first;
     cout << setw(5) << ++numCostars << ".) " << costar;
-    if (curr->second.size() > 1) cout << " (in " << (int) curr->second.size() << " different films)";
+    if (curr->second.second > 1) cout << " (in " << curr->second.second << " different films)";
     cout << endl;
   }
 
@@ -118,9 +123,9 @@ static void listCostars(const string &player, const vector<film>& credits, const
     if (costars.size() > 2 * kNumCostarsToPrint) printFill();
     while (numCostars < costars.size() - kNumCostarsToPrint) { numCostars++; ++curr; }
     for (; curr != costars.end(); ++curr) {
-      const string& costar = curr->first;
+      string_view costar = curr->first;
       cout << setw(5) << ++numCostars << ".) " << costar;
-      if (curr->second.size() > 1) cout << " (in " << (int) curr->second.size() << " different films)";
+      if (curr->second.second > 1) cout << " (in " << curr->second.second << " different films)";
       cout << endl;
     }
   }
@@ -152,7 +157,7 @@ static void listCostars(const string &player, const vector<film>& credits, const
 static void listAllMoviesAndCostars(const string& player,
 				    const imdb& db)
 {
-  vector<film> credits;
+  filmRange credits;
   if (!db.getCredits(player, credits) || credits.size() == 0) {
     cout << "We're sorry, but " << player 
 	 << " doesn't appear to be in our database." << endl;
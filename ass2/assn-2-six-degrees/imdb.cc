@@ -7,6 +7,7 @@ using namespace std;
 #include <unistd.h>
 #include "imdb.h"
 #include <string.h>
+#include <errno.h>
 
 const char *const imdb::kActorFileName = "actordata";
 const char *const imdb::kMovieFileName = "moviedata";
@@ -17,13 +18,13 @@ struct key{
   const void* baseArray;
 };
 
-imdb::imdb(const string& directory)
+imdb::imdb(const string& directory, int loadPolicy)
 {
   const string actorFileName = directory + "/" + kActorFileName;
   const string movieFileName = directory + "/" + kMovieFileName;
   
-  actorFile = acquireFileMap(actorFileName, actorInfo);
-  movieFile = acquireFileMap(movieFileName, movieInfo);
+  actorFile = acquireFileMap(actorFileName, actorInfo, loadPolicy);
+  movieFile = acquireFileMap(movieFileName, movieInfo, loadPolicy);
 }
 
 bool imdb::good() const
@@ -45,79 +46,183 @@ int compareActors(const void* ptr1, const void* ptr2){
   return strcmp((char*)keyPlayer.value, s2);   
 }
 
+/* What a film search looks for; the title needn't be '\0'-terminated */
+struct filmKey{
+  string_view title;
+  int year;
+};
+
+/**
+  Compares the key's title bytes and year directly against the record,
+  in the same order as film::operator<, without building any films.
+*/
 int compareFilms(const void* ptr1, const void* ptr2){
-  key keyMovie = *(key*)ptr1;
-  film movie1 = *(film*)(keyMovie.value);
-  film movie2;
-  char* record = (char*)((char*)keyMovie.baseArray + *(int*)ptr2);
-  movie2.title = record;
-  record += (strlen(record) + 1);
-  movie2.year = 1900 + *record;
-  if(movie1 < movie2){
-    return -1;
-  }else if(movie1 == movie2){
-    return 0;
+  const key* keyMovie = (const key*)ptr1;
+  const filmKey* movie = (const filmKey*)keyMovie->value;
+  const char* record = (const char*)keyMovie->baseArray + *(const int*)ptr2;
+  size_t length = movie->title.size();
+  int result = strncmp(movie->title.data(), record, length);
+  if(result != 0) return result;
+  if(record[length] != '\0') return -1;   // the record's title is longer
+  return movie->year - (1900 + record[length + 1]);
+}
+
+
+/**
+  FNV-1a over the name, with the year (0 for actors) folded in last.
+*/
+uint64_t imdb::hashName(const char *name, size_t length, int year)
+{
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  for (size_t i = 0; i < length; i++)
+    hash = (hash ^ (unsigned char) name[i]) * 0x100000001b3ULL;
+  hash = (hash ^ (uint64_t) year) * 0x100000001b3ULL;
+  return hash ^ (hash >> 29);
+}
+
+void imdb::buildIndex(const void *file, int numExtraBytes, vector<indexEntry>& index)
+{
+  int count = *(const int *)file;
+  const int *offsets = (const int *)file + 1;
+  size_t size = 16;
+  while (size < 2 * (size_t) count) size *= 2;
+  indexEntry empty = { 0, -1 };
+  index.assign(size, empty);
+  for (int i = 0; i < count; i++) {
+    const char *name = (const char *)file + offsets[i];
+    size_t length = strlen(name);
+    uint64_t hash = hashName(name, length, numExtraBytes == 0 ? 0 : 1900 + name[length + 1]);
+    size_t j = hash & (size - 1);
+    while (index[j].slot != -1) j = (j + 1) & (size - 1);
+    index[j].tag = hash >> 32;
+    index[j].slot = i;
   }
-  return 1;
 }
 
+void imdb::buildNameIndex()
+{
+  buildIndex(actorFile, 0, actorIndex);
+  buildIndex(movieFile, 1, movieIndex);
+}
+
+const int *imdb::findActor(const string& player) const
+{
+  const int *offsets = (const int *)actorFile + 1;
+  if (!actorIndex.empty()) {
+    uint64_t hash = hashName(player.data(), player.size(), 0);
+    size_t mask = actorIndex.size() - 1;
+    for (size_t j = hash & mask; actorIndex[j].slot != -1; j = (j + 1) & mask) {
+      const indexEntry& entry = actorIndex[j];
+      if (entry.tag == (uint32_t) (hash >> 32) &&
+          strcmp((const char *)actorFile + offsets[entry.slot], player.c_str()) == 0)
+        return offsets + entry.slot;
+    }
+    return NULL;
+  }
 
-bool imdb::getCredits(const string& player, vector<film>& films) const {
   key toCompare{
-    &(player[0]), // void* value;
-    actorFile,    // void* baseArray;
+    player.c_str(), // void* value;
+    actorFile,      // void* baseArray;
   };
-  int* offset_array = (int*)actorFile + 1;
-  int player_num = *(int*)actorFile;
-  void* start = bsearch(&toCompare, offset_array, player_num, sizeof(int), compareActors);
-  if(start == NULL) return false;
-  char* player_record = (char*)actorFile + *(int*)start;
-  player_record += (strlen(player_record) + 1);
-  if(((char*)player_record - (char*)actorFile) % 2 == 1) 
-    player_record++;
-  int movie_num = *(short*)player_record;
-  player_record += 2;
-  if(((char*)player_record - (char*)actorFile) % 4 != 0) 
-    player_record += 2;
-  int* offset = (int*)player_record;
-  for(int i = 0; i < movie_num; i++){
-    film toAdd;
-    char* movie_record = (char*)movieFile + *offset;
-    toAdd.title = movie_record;
-    movie_record += (strlen(movie_record) + 1);
-    toAdd.year = 1900 + *(char*)movie_record;
-    films.push_back(toAdd);
-    offset++;
+  return (const int *) bsearch(&toCompare, (int*)actorFile + 1, *(int*)actorFile, sizeof(int), compareActors);
+}
+
+const int *imdb::findMovie(string_view title, int year) const
+{
+  const int *offsets = (const int *)movieFile + 1;
+  if (!movieIndex.empty()) {
+    uint64_t hash = hashName(title.data(), title.size(), year);
+    size_t mask = movieIndex.size() - 1;
+    for (size_t j = hash & mask; movieIndex[j].slot != -1; j = (j + 1) & mask) {
+      const indexEntry& entry = movieIndex[j];
+      if (entry.tag != (uint32_t) (hash >> 32)) continue;
+      const char *record = (const char *)movieFile + offsets[entry.slot];
+      if (strncmp(record, title.data(), title.size()) == 0 && record[title.size()] == '\0' &&
+          1900 + record[title.size() + 1] == year)
+        return offsets + entry.slot;
+    }
+    return NULL;
   }
 
+  filmKey movie{ title, year };
+  key toCompare{
+    &movie,   // void* value;
+    movieFile,// void* baseArray;
+  };
+  return (const int *) bsearch(&toCompare, (int*)movieFile + 1, *(int*)movieFile, sizeof(int), compareFilms);
+}
+
+/**
+  Records are laid out as a '\0'-terminated name, numExtraBytes more
+  bytes, padding to an even offset, a short count, padding to a multiple
+  of four, and then count ints.
+*/
+const int *imdb::getRecordOffsets(const void *file, int recordOffset, int numExtraBytes, int& count)
+{
+  const char* record = (const char*)file + recordOffset;
+  record += strlen(record) + 1 + numExtraBytes;
+  if ((record - (const char*)file) % 2 == 1)
+    record++;
+  count = *(short*)record;
+  record += 2;
+  if ((record - (const char*)file) % 4 != 0)
+    record += 2;
+  return (const int*)record;
+}
+
+film imdb::getMovieRecord(const void *file, int recordOffset)
+{
+  film movie;
+  const char* record = (const char*)file + recordOffset;
+  movie.title = record;
+  movie.year = 1900 + *(record + movie.title.size() + 1);
+  return movie;
+}
+
+bool imdb::getCredits(const string& player, filmRange& films) const {
+  const int* slot = findActor(player);
+  if(slot == NULL) return false;
+  int movie_num;
+  const int* offsets = getRecordOffsets(actorFile, *slot, 0, movie_num);
+  films = filmRange(movieFile, offsets, movie_num);
+  return true;
+}
+
+bool imdb::getCast(const film& movie, playerRange& players) const {
+  return getCast(movie.title, movie.year, players);
+}
+
+bool imdb::getCast(string_view title, int year, playerRange& players) const {
+  const int* slot = findMovie(title, year);
+  if(slot == NULL) return false;
+  int num_cast;
+  const int* offsets = getRecordOffsets(movieFile, *slot, 1, num_cast);
+  players = playerRange(actorFile, offsets, num_cast);
   return true;
 }
 
+void imdb::getCast(const filmView& movie, playerRange& players) const {
+  int num_cast;
+  const int* offsets = getRecordOffsets(movieFile, movie.record, 1, num_cast);
+  players = playerRange(actorFile, offsets, num_cast);
+}
 
+/**
+  The string-based accessors are wrappers around the views.
+*/
+bool imdb::getCredits(const string& player, vector<film>& films) const {
+  filmRange credits;
+  if(!getCredits(player, credits)) return false;
+  for(filmRange::iterator curr = credits.begin(); curr != credits.end(); ++curr)
+    films.push_back(*curr);
+  return true;
+}
 
 bool imdb::getCast(const film& movie, vector<string>& players) const {
-  key toCompare{
-    &movie,   // void* value;
-    movieFile,// void* baseArray;
-  };
-  int *offset_array = (int*)movieFile + 1;
-  void* ptr = bsearch(&toCompare, offset_array, *(int*)movieFile, sizeof(int), compareFilms);
-  if(ptr == NULL) return false;
-	int offset = *(int*)ptr;
-	char* start = (char*)movieFile + offset;
-  start += (strlen(start) + 2);
-  if(((char*)start - (char*)movieFile) % 2 == 1)
-  	start++;
-  short num_cast = *(short*)start;
-  start += 2;
-  if(((char*)start - (char*)movieFile) % 4 != 0)
-  	start += 2;
-  int* player_offsets = (int*)start;
-  for(int i = 0; i < num_cast; i++){ //pushes player names into a vector;
-  	char* name = (char*)actorFile + *player_offsets;
-  	players.push_back(name);
-  	player_offsets++;
-  }
+  playerRange cast;
+  if(!getCast(movie, cast)) return false;
+  for(playerRange::iterator curr = cast.begin(); curr != cast.end(); ++curr) //pushes player names into a vector;
+    players.push_back(string(*curr));
   return true;
 }
 
@@ -129,17 +234,60 @@ imdb::~imdb()
 
 // ignore everything below... it's all UNIXy stuff in place to make a file look like
 // an array of bytes in RAM.. 
-const void *imdb::acquireFileMap(const string& fileName, struct fileInfo& info)
+const void *imdb::acquireFileMap(const string& fileName, struct fileInfo& info, int loadPolicy)
 {
   struct stat stats;
   stat(fileName.c_str(), &stats);
-  info.fileSize = stats.st_size;
+  info.fileSize = info.mapSize = stats.st_size;
   info.fd = open(fileName.c_str(), O_RDONLY);
-  return info.fileMap = mmap(0, info.fileSize, PROT_READ, MAP_SHARED, info.fd, 0);
+  int flags = MAP_SHARED | ((loadPolicy & (kPrefault | kHugePages)) ? MAP_POPULATE : 0);
+  info.fileMap = mmap(0, info.fileSize, PROT_READ, flags, info.fd, 0);
+  if (info.fd == -1 || info.fileMap == MAP_FAILED) return info.fileMap;
+
+  const void *copy = (loadPolicy & kHugePages) ? copyToHugePages(info.fileMap, info.fileSize, info.mapSize) : NULL;
+  if (copy != NULL) {
+    munmap((void *) info.fileMap, info.fileSize);
+    info.fileMap = copy;
+  } else {
+    if (loadPolicy & kWillNeed) madvise((void *) info.fileMap, info.fileSize, MADV_WILLNEED);
+    if (loadPolicy & kRandom) madvise((void *) info.fileMap, info.fileSize, MADV_RANDOM);
+  }
+  if ((loadPolicy & kLock) && mlock(info.fileMap, info.mapSize) != 0)
+    cerr << "Couldn't lock " << fileName << " into memory: " << strerror(errno) << endl;
+  return info.fileMap;
+}
+
+/**
+ * Copies the file into a fresh anonymous mapping, rounded out to whole
+ * 2MB huge pages and aligned on one, so that every page of it is eligible
+ * for a transparent huge page, and returns the copy, which is read only
+ * from then on.  Returns NULL, leaving the file mapped, if the memory can't
+ * be had.
+ */
+
+static const size_t kHugePageSize = 2 << 20;
+
+const void *imdb::copyToHugePages(const void *fileMap, size_t fileSize, size_t& mapSize)
+{
+  size_t size = (fileSize + kHugePageSize - 1) / kHugePageSize * kHugePageSize;
+  char *region = (char *) mmap(0, size + kHugePageSize, PROT_READ | PROT_WRITE,
+                               MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (region == MAP_FAILED) return NULL;
+
+  // trim the slack on either side of the first aligned huge page
+  char *aligned = (char *) (((uintptr_t) region + kHugePageSize - 1) & ~(uintptr_t) (kHugePageSize - 1));
+  if (aligned > region) munmap(region, aligned - region);
+  munmap(aligned + size, region + kHugePageSize - aligned);
+
+  madvise(aligned, size, MADV_HUGEPAGE);
+  memcpy(aligned, fileMap, fileSize);
+  mprotect(aligned, size, PROT_READ);
+  mapSize = size;
+  return aligned;
 }
 
 void imdb::releaseFileMap(struct fileInfo& info)
 {
-  if (info.fileMap != NULL) munmap((char *) info.fileMap, info.fileSize);
+  if (info.fileMap != NULL && info.fileMap != MAP_FAILED) munmap((char *) info.fileMap, info.mapSize);
   if (info.fd != -1) close(info.fd);
 }
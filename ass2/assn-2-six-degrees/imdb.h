@@ -3,9 +3,94 @@
 
 #include "imdb-utils.h"
 #include <string>
+#include <string_view>
 #include <vector>
+#include <stdint.h>
+#include <string.h>
 using namespace std;
 
+/**
+ * Struct: filmView
+ * ----------------
+ * The allocation-free counterpart of a film: the title addresses the
+ * movie record inside the mapped data file, and record is that record's
+ * offset, which lets the imdb jump straight to the movie's cast.  A
+ * filmView is only good for as long as the imdb that produced it.
+ */
+
+struct filmView {
+  string_view title;
+  int year;
+  int record;
+
+  operator film() const {
+    film movie;
+    movie.title = string(title);
+    movie.year = year;
+    return movie;
+  }
+};
+
+/**
+ * Class: recordRange
+ * ------------------
+ * A lightweight view of a run of record offsets stored inside one of
+ * the data files, like an actor's credits or a movie's cast.  Iterating
+ * hands back each record decoded by decode (a string_view of an actor's
+ * name, say), computed on the fly, so nothing is copied or allocated.
+ * offsets exposes the raw offsets themselves.
+ */
+
+template <typename View, View (*decode)(const void *file, int offset)>
+class recordRange {
+
+ public:
+
+  class iterator {
+   public:
+    iterator(const void *file, const int *offset) : file(file), offset(offset) {}
+    View operator*() const { return decode(file, *offset); }
+    iterator& operator++() { ++offset; return *this; }
+    bool operator==(const iterator& rhs) const { return offset == rhs.offset; }
+    bool operator!=(const iterator& rhs) const { return offset != rhs.offset; }
+
+   private:
+    const void *file;
+    const int *offset;
+  };
+
+  recordRange() : file(NULL), first(NULL), count(0) {}
+  recordRange(const void *file, const int *first, int count) : file(file), first(first), count(count) {}
+
+  iterator begin() const { return iterator(file, first); }
+  iterator end() const { return iterator(file, first + count); }
+  size_t size() const { return count; }
+  bool empty() const { return count == 0; }
+  View operator[](int i) const { return decode(file, first[i]); }
+  const int *offsets() const { return first; }
+
+ private:
+  const void *file;     // the file the offsets point into
+  const int *first;
+  int count;
+};
+
+inline string_view decodePlayer(const void *file, int offset)
+{
+  return string_view((const char *) file + offset);
+}
+
+inline filmView decodeFilm(const void *file, int offset)
+{
+  const char *title = (const char *) file + offset;
+  size_t length = strlen(title);
+  filmView movie = { string_view(title, length), 1900 + title[length + 1], offset };
+  return movie;
+}
+
+typedef recordRange<string_view, decodePlayer> playerRange;
+typedef recordRange<filmView, decodeFilm> filmRange;
+
 class imdb {
   
  public:
@@ -20,9 +105,37 @@ class imdb {
    * application (like six-degrees).
    *
    * @param directory the name of the directory housing the formatted information backing the imdb.
+   * @param loadPolicy any combination of the load policy flags below, or 0 to
+   *                   just map the files and let pages fault in as they're touched.
+   */
+
+  imdb(const string& directory, int loadPolicy = 0);
+
+  /**
+   * Constants: load policy flags
+   * ----------------------------
+   * By default the data files are mapped and read in a page at a time, as
+   * records are first touched, so the first lookups after startup stall on
+   * scattered disk reads.  These trade startup time and memory for steadier
+   * lookups:
+   *
+   *     kPrefault  reads both files in before the constructor returns (MAP_POPULATE).
+   *     kWillNeed  starts reading both files in, but doesn't wait (MADV_WILLNEED).
+   *     kRandom    turns off readahead around each fault (MADV_RANDOM), since
+   *                lookups hop around the files.
+   *     kLock      locks the files into memory (mlock), so they're never paged out.
+   *                Failing to lock, typically for lack of RLIMIT_MEMLOCK, is
+   *                reported but isn't fatal.
+   *     kHugePages copies the files into anonymous memory that the kernel may
+   *                back with transparent huge pages, for fewer TLB misses.  The
+   *                copy reads the files in completely, like kPrefault.
    */
 
-  imdb(const string& directory);
+  static const int kPrefault = 1;
+  static const int kWillNeed = 2;
+  static const int kRandom = 4;
+  static const int kLock = 8;
+  static const int kHugePages = 16;
 
   /**
    * Predicate Method: good
@@ -74,6 +187,36 @@ class imdb {
 
   bool getCast(const film& movie, vector<string>& players) const;
 
+  /**
+   * Methods: getCredits, getCast (view versions)
+   * --------------------------------------------
+   * Like the versions above, except that rather than copying names and
+   * titles into strings, they set the range to view the credits or cast
+   * in place, inside the mapped files.  Nothing is allocated, and the
+   * title and year version doesn't even need a film to search for.  The
+   * filmView version of getCast doesn't even need to search, since the
+   * filmView knows where its record is.
+   */
+
+  bool getCredits(const string& player, filmRange& films) const;
+  bool getCast(const film& movie, playerRange& players) const;
+  bool getCast(string_view title, int year, playerRange& players) const;
+  void getCast(const filmView& movie, playerRange& players) const;
+
+  /**
+   * Method: buildNameIndex
+   * ----------------------
+   * Hashes every actor name and every movie title and year into
+   * in-memory tables, after which getCredits and getCast find records
+   * with a hash probe (typically one cache miss for the table and one
+   * for the record) instead of a binary search that lands on a new page
+   * at every step.  Building touches every record once, so it's worth
+   * it only for clients that look up many names; without it, lookups
+   * fall back to binary search.
+   */
+
+  void buildNameIndex();
+
   /**
    * Destructor: ~imdb
    * -----------------
@@ -89,6 +232,45 @@ class imdb {
   const void *actorFile;
   const void *movieFile;
 
+  // the graph class walks the raw records to build its adjacency arrays
+  friend class graph;
+
+  /**
+   * Record helpers
+   * --------------
+   * findActor and findMovie binary search the sorted offset arrays and
+   * return the matching slot (or NULL), so the slot's index doubles as a
+   * dense id.  getRecordOffsets skips over a record's name (plus
+   * numExtraBytes bytes, like a movie's year) and its padding, sets count
+   * to the number of offsets that follow, and returns their address.
+   */
+
+  const int *findActor(const string& player) const;
+  const int *findMovie(string_view title, int year) const;
+  static const int *getRecordOffsets(const void *file, int recordOffset, int numExtraBytes, int& count);
+  static film getMovieRecord(const void *file, int recordOffset);
+
+  /**
+   * Struct: indexEntry
+   * ------------------
+   * One slot of a name index, an open addressing table with linear
+   * probing kept at most half full.  slot is the record's position in
+   * the sorted offset array (or -1 for an empty table slot), and tag holds
+   * the high bits of its hash, so that most mismatches are rejected
+   * without touching the record.
+   */
+
+  struct indexEntry {
+    uint32_t tag;
+    int32_t slot;
+  };
+
+  vector<indexEntry> actorIndex;   // empty until buildNameIndex is called
+  vector<indexEntry> movieIndex;
+
+  static uint64_t hashName(const char *name, size_t length, int year);
+  static void buildIndex(const void *file, int numExtraBytes, vector<indexEntry>& index);
+
   
   // everything below here is complicated and needn't be touched.
   // you're free to investigate, but you're on your own.
@@ -96,9 +278,11 @@ class imdb {
     int fd;
     size_t fileSize;
     const void *fileMap;
+    size_t mapSize;       // fileSize, unless the file was copied into huge pages
   } actorInfo, movieInfo;
   
-  static const void *acquireFileMap(const string& fileName, struct fileInfo& info);
+  static const void *acquireFileMap(const string& fileName, struct fileInfo& info, int loadPolicy);
+  static const void *copyToHugePages(const void *fileMap, size_t fileSize, size_t& mapSize);
   static void releaseFileMap(struct fileInfo& info);
 
   // marked as private so imdbs can't be copy constructed or reassigned.
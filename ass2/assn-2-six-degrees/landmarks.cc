@@ -0,0 +1,154 @@
+#include "landmarks.h"
+#include <algorithm>
+#include <fstream>
+#include <string.h>
+using namespace std;
+
+/**
+ * The file starts with this header, followed by the landmarks' ids
+ * (count ints) and then the distances (numActors * count bytes).
+ */
+
+static const char kMagic[4] = { 'S', 'D', 'L', 'M' };
+static const int kVersion = 1;
+
+struct landmarkHeader {
+  char magic[4];
+  int32_t version;
+  int32_t numActors;
+  int32_t numMovies;
+  int32_t count;
+};
+
+/**
+ * Method: search
+ * --------------
+ * Sets found[a] to the number of films separating actor a from the
+ * specified landmark, or kUnreachable, by breadth-first search.
+ */
+
+void landmarks::search(const graph& g, int landmark, vector<uint8_t>& found) const
+{
+  found.assign(g.getNumActors(), kUnreachable);
+  vector<bool> expanded(g.getNumMovies(), false);
+  vector<int> frontier(1, landmark), next;
+  found[landmark] = 0;
+  for (int depth = 1; !frontier.empty(); depth++) {
+    next.clear();
+    for (size_t i = 0; i < frontier.size(); i++) {
+      for (const int *movie = g.creditsBegin(frontier[i]); movie != g.creditsEnd(frontier[i]); movie++) {
+        if (expanded[*movie]) continue;
+        expanded[*movie] = true;
+        for (const int *costar = g.castBegin(*movie); costar != g.castEnd(*movie); costar++) {
+          if (found[*costar] != kUnreachable) continue;
+          found[*costar] = min(depth, kUnreachable - 1);
+          next.push_back(*costar);
+        }
+      }
+    }
+    frontier.swap(next);
+  }
+}
+
+static bool moreCredits(const pair<int, int>& a, const pair<int, int>& b)
+{
+  return a.first > b.first || (a.first == b.first && a.second < b.second);
+}
+
+void landmarks::build(const graph& g, int count)
+{
+  numActors = g.getNumActors();
+  numMovies = g.getNumMovies();
+  vector<pair<int, int> > candidates(numActors);
+  for (int a = 0; a < numActors; a++)
+    candidates[a] = make_pair((int) (g.creditsEnd(a) - g.creditsBegin(a)), a);
+  sort(candidates.begin(), candidates.end(), moreCredits);
+
+  ids.clear();
+  vector<vector<uint8_t> > found;
+  for (int i = 0; i < numActors && (int) ids.size() < count; i++) {
+    int actor = candidates[i].second;
+    bool covered = false;
+    for (size_t l = 0; l < found.size() && !covered; l++)
+      covered = found[l][actor] <= 1;
+    if (covered) continue;
+    ids.push_back(actor);
+    found.push_back(vector<uint8_t>());
+    search(g, actor, found.back());
+  }
+
+  distances.resize((size_t) numActors * ids.size());
+  for (int a = 0; a < numActors; a++)
+    for (size_t l = 0; l < ids.size(); l++)
+      distances[(size_t) a * ids.size() + l] = found[l][a];
+}
+
+bool landmarks::save(const string& fileName) const
+{
+  ofstream out(fileName.c_str(), ios::binary);
+  landmarkHeader header;
+  memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kVersion;
+  header.numActors = numActors;
+  header.numMovies = numMovies;
+  header.count = ids.size();
+  out.write((const char *) &header, sizeof(header));
+  out.write((const char *) ids.data(), ids.size() * sizeof(int));
+  out.write((const char *) distances.data(), distances.size());
+  out.close();
+  return !out.fail();
+}
+
+bool landmarks::load(const string& fileName, const graph& g)
+{
+  ids.clear();
+  distances.clear();
+  ifstream in(fileName.c_str(), ios::binary | ios::ate);
+  streamoff fileSize = in.tellg();
+  landmarkHeader header;
+  if (!in.seekg(0) || !in.read((char *) &header, sizeof(header))) return false;
+  if (memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 || header.version != kVersion ||
+      header.numActors != g.getNumActors() || header.numMovies != g.getNumMovies() ||
+      header.count <= 0)
+    return false;
+
+  // the header is checked against the file's size before anything is allocated for it
+  uint64_t expectedSize = sizeof(header) + (uint64_t) header.count * (sizeof(int) + header.numActors);
+  if (fileSize < 0 || (uint64_t) fileSize != expectedSize) return false;
+
+  vector<int> fileIds(header.count);
+  vector<uint8_t> fileDistances((size_t) header.numActors * header.count);
+  if (!in.read((char *) fileIds.data(), fileIds.size() * sizeof(int)) ||
+      !in.read((char *) fileDistances.data(), fileDistances.size()))
+    return false;
+  for (size_t l = 0; l < fileIds.size(); l++)
+    if (fileIds[l] < 0 || fileIds[l] >= header.numActors) return false;
+
+  numActors = header.numActors;
+  numMovies = header.numMovies;
+  ids.swap(fileIds);
+  distances.swap(fileDistances);
+  return true;
+}
+
+int landmarks::lowerBound(int actor1, int actor2) const
+{
+  const uint8_t *row1 = distances.data() + (size_t) actor1 * ids.size();
+  const uint8_t *row2 = distances.data() + (size_t) actor2 * ids.size();
+  int bound = 0;
+  for (size_t l = 0; l < ids.size(); l++) {
+    if ((row1[l] == kUnreachable) != (row2[l] == kUnreachable)) return kUnreachable;
+    bound = max(bound, abs(row1[l] - row2[l]));
+  }
+  return bound;
+}
+
+int landmarks::upperBound(int actor1, int actor2) const
+{
+  const uint8_t *row1 = distances.data() + (size_t) actor1 * ids.size();
+  const uint8_t *row2 = distances.data() + (size_t) actor2 * ids.size();
+  int bound = kUnreachable;
+  for (size_t l = 0; l < ids.size(); l++)
+    bound = min(bound, row1[l] + row2[l]);
+  return bound;
+}
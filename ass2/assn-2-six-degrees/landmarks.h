@@ -0,0 +1,92 @@
+#ifndef __landmarks__
+#define __landmarks__
+
+#include "graph.h"
+#include <string>
+#include <vector>
+#include <stdint.h>
+using namespace std;
+
+/**
+ * Class: landmarks
+ * ----------------
+ * The distance (in films) from each of a handful of landmark actors to
+ * every actor in a graph, computed once by breadth-first search and kept
+ * in a file so later runs can just load it.  By the triangle inequality,
+ * no two actors can be closer together than the difference of their
+ * distances to any one landmark, nor farther apart than the sum, which
+ * bounds the distance between any two actors with a few byte lookups.
+ * The distances are stored actor by actor, so an actor's distances to
+ * every landmark share a cache line or two.
+ */
+
+class landmarks {
+
+ public:
+
+  /**
+   * Constant: kUnreachable
+   * ----------------------
+   * Stands in for the distance to an actor a landmark can't reach, and
+   * is what lowerBound returns when two actors can't be connected.
+   */
+
+  static const int kUnreachable = 255;
+
+  /**
+   * Constructor: landmarks
+   * ----------------------
+   * Constructs an empty set of landmarks, which bounds nothing until
+   * build or load is called.
+   */
+
+  landmarks() : numActors(0), numMovies(0) {}
+
+  /**
+   * Method: build
+   * -------------
+   * Chooses up to count landmarks, favoring actors with the most credits
+   * but skipping any that shares a film with a landmark already chosen,
+   * and runs a full breadth-first search from each.  This touches the
+   * whole graph once per landmark.
+   */
+
+  void build(const graph& g, int count);
+
+  /**
+   * Methods: save, load
+   * -------------------
+   * Write the landmarks to, or read them back from, the named file.
+   * load fails (and leaves the landmarks empty) if the file is missing or
+   * malformed, or was built from a graph with different actor or movie
+   * counts than the specified one.  Both return true on success.
+   */
+
+  bool save(const string& fileName) const;
+  bool load(const string& fileName, const graph& g);
+
+  bool empty() const { return ids.empty(); }
+  int size() const { return ids.size(); }
+
+  /**
+   * Methods: lowerBound, upperBound
+   * -------------------------------
+   * Bound the number of films separating the two actors.  lowerBound
+   * returns kUnreachable if some landmark reaches exactly one of them, and
+   * upperBound returns kUnreachable if no landmark reaches both.  Both
+   * return 0 and kUnreachable when there are no landmarks.
+   */
+
+  int lowerBound(int actor1, int actor2) const;
+  int upperBound(int actor1, int actor2) const;
+
+ private:
+  int numActors;
+  int numMovies;
+  vector<int> ids;                // the landmarks' actor ids
+  vector<uint8_t> distances;      // distances[actor * size() + l], in films
+
+  void search(const graph& g, int landmark, vector<uint8_t>& found) const;
+};
+
+#endif
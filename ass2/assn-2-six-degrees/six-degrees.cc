@@ -5,7 +5,16 @@
 #include <iostream>
 #include <iomanip>
 #include <queue>
+#include <fstream>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
 #include "imdb.h"
+#include "graph.h"
+#include "landmarks.h"
 #include "path.h"
 using namespace std;
 
@@ -31,7 +40,7 @@ static string promptForActor(const string& prompt, const imdb& db)
     cout << prompt << " [or <enter> to quit]: ";
     getline(cin, response);
     if (response == "") return "";
-    vector<film> credits;
+    filmRange credits;
     if (db.getCredits(response, credits)) return response;
     cout << "We couldn't find \"" << response << "\" in the movie database. "
 	 << "Please try again." << endl;
@@ -39,68 +48,510 @@ static string promptForActor(const string& prompt, const imdb& db)
 }
 
 
-void generateShortestPath(string player1, string player2, imdb& db){
-  queue<path> bfsQ; 
-  path startPath(player1);
-  bfsQ.push(startPath);
-  set<film> visitedMovies;
-  set<string> visitedPlayers;
-  while(!bfsQ.empty()){
-    path currPath = bfsQ.front();
-    string lastPlayer = currPath.getLastPlayer();
-    bfsQ.pop();
-    if(currPath.getLength() >= 5)break;
-    vector<film> movies;
-    db.getCredits(lastPlayer, movies);
-    for(int i = 0; i < movies.size(); i++){
-      if(visitedMovies.find(movies[i]) == visitedMovies.end()){
-        vector<string> cast;
-        db.getCast(movies[i], cast);
-        for(int j = 0; j < cast.size(); j++){
-          path copy = currPath;
-          if(cast[j] != player1 && visitedPlayers.find(cast[j]) == visitedPlayers.end()){
-            copy.addConnection(movies[i], cast[j]);
-            if(cast[j] == player2){
-              cout << copy << endl;
-              return;
-            }
-            bfsQ.push(copy);
-            visitedPlayers.insert(cast[j]);
-          }
+/**
+ * Constant: kMaxPathLength
+ * ------------------------
+ * The longest path (in films) generateShortestPath is willing to look for.
+ */
+
+static const int kMaxPathLength = 5;
+
+/**
+ * Struct: link
+ * ------------
+ * Records how the search reached a player: through movie, from the
+ * neighboring player one step closer to the side's starting player.
+ * Both are graph ids; the starting player's link holds -1s.
+ */
+
+struct link {
+  int movie;
+  int player;
+};
+
+/**
+ * Struct: searchSide
+ * ------------------
+ * Everything one direction of the bidirectional search knows: the
+ * players discovered at the most recent depth, which players have been
+ * discovered and how, and which films have already had their casts walked
+ * (so no film is expanded twice from the same side).  Membership lives in
+ * bitmaps indexed by graph id, and parents[p] is meaningful only for players
+ * whose bit is set.  The ids of set bits are also listed in seen and expanded,
+ * so that reset can clear just those rather than every word of the bitmaps.
+ */
+
+struct searchSide {
+  vector<int> frontier;
+  vector<int> next;
+  vector<uint64_t> seenPlayers;
+  vector<uint64_t> expandedMovies;
+  vector<link> parents;
+  vector<int> seen;
+  vector<int> expanded;
+  int depth;
+};
+
+/**
+ * Struct: searchScratch
+ * ---------------------
+ * The memory a search needs, sized for a particular graph and
+ * reused from one search to the next.
+ */
+
+struct searchScratch {
+  searchSide sides[2];
+};
+
+static bool testBit(const vector<uint64_t>& bits, int i) { return (bits[i >> 6] >> (i & 63)) & 1; }
+static void setBit(vector<uint64_t>& bits, int i) { bits[i >> 6] |= 1ULL << (i & 63); }
+static void clearBit(vector<uint64_t>& bits, int i) { bits[i >> 6] &= ~(1ULL << (i & 63)); }
+
+/**
+ * Function: initScratch
+ * ---------------------
+ * Sizes the specified scratch for the specified graph.
+ */
+
+static void initScratch(searchScratch& scratch, const graph& g)
+{
+  for (int s = 0; s < 2; s++) {
+    searchSide& side = scratch.sides[s];
+    side.seenPlayers.assign((g.getNumActors() + 63) / 64, 0);
+    side.expandedMovies.assign((g.getNumMovies() + 63) / 64, 0);
+    side.parents.resize(g.getNumActors());
+  }
+}
+
+/**
+ * Function: startSide
+ * -------------------
+ * Clears whatever the previous search left behind in the specified
+ * side and seeds it with the specified player.
+ */
+
+static void startSide(searchSide& side, int player)
+{
+  for (int i = 0; i < (int) side.seen.size(); i++) clearBit(side.seenPlayers, side.seen[i]);
+  for (int i = 0; i < (int) side.expanded.size(); i++) clearBit(side.expandedMovies, side.expanded[i]);
+  side.seen.clear();
+  side.expanded.clear();
+  side.frontier.clear();
+  side.frontier.push_back(player);
+  setBit(side.seenPlayers, player);
+  side.seen.push_back(player);
+  link none = { -1, -1 };
+  side.parents[player] = none;
+  side.depth = 0;
+}
+
+/**
+ * Function: expandLevel
+ * ---------------------
+ * Replaces the side's frontier with every player one film away from
+ * it that the side hasn't seen yet.  Returns true, after setting meeting
+ * to the player in question, as soon as a player the other side has
+ * already discovered turns up.  Because whole levels are expanded at a
+ * time, the first such player lies on a shortest path.
+ */
+
+static bool expandLevel(searchSide& side, const searchSide& other, const graph& g, int& meeting)
+{
+  side.next.clear();
+  for (int i = 0; i < (int) side.frontier.size(); i++) {
+    int player = side.frontier[i];
+    for (const int *movie = g.creditsBegin(player); movie != g.creditsEnd(player); movie++) {
+      if (testBit(side.expandedMovies, *movie)) continue;
+      setBit(side.expandedMovies, *movie);
+      side.expanded.push_back(*movie);
+      for (const int *costar = g.castBegin(*movie); costar != g.castEnd(*movie); costar++) {
+        if (testBit(side.seenPlayers, *costar)) continue;
+        setBit(side.seenPlayers, *costar);
+        side.seen.push_back(*costar);
+        link reached = { *movie, player };
+        side.parents[*costar] = reached;
+        if (testBit(other.seenPlayers, *costar)) {
+          meeting = *costar;
+          return true;
         }
-        visitedMovies.insert(movies[i]);
+        side.next.push_back(*costar);
       }
     }
   }
-  cout << "No path between those two people could be found." << endl;
+
+  side.frontier.swap(side.next);
+  side.depth++;
+  return false;
 }
 
+/**
+ * Function: meetInTheMiddle
+ * -------------------------
+ * Searches outward from both players at once, always expanding whichever
+ * side has the smaller frontier, until the two searches meet or the
+ * frontiers together span kMaxPathLength films.  Returns true, after
+ * setting meeting to a player on a shortest path, if they meet.  The
+ * path then spans sides[0].depth + sides[1].depth + 1 films.
+ */
 
+static bool meetInTheMiddle(int source, int target, const graph& g, searchScratch& scratch, int& meeting)
+{
+  searchSide *sides = scratch.sides;
+  startSide(sides[0], source);
+  startSide(sides[1], target);
 
+  while (sides[0].depth + sides[1].depth < kMaxPathLength &&
+         !sides[0].frontier.empty() && !sides[1].frontier.empty()) {
+    int s = sides[0].frontier.size() <= sides[1].frontier.size() ? 0 : 1;
+    if (expandLevel(sides[s], sides[1 - s], g, meeting)) return true;
+  }
+  return false;
+}
+
+/**
+ * Function: findShortestPath
+ * --------------------------
+ * If the two players are connected by kMaxPathLength films or fewer,
+ * pieces the path (which must start out as just player1) together from
+ * the parent links of both sides, and returns true.  If the landmarks
+ * prove the players are farther apart than that, there's no search.
+ */
+
+static bool findShortestPath(int source, int target, const graph& g, const landmarks& marks,
+                             searchScratch& scratch, path& result)
+{
+  if (!marks.empty() && marks.lowerBound(source, target) > kMaxPathLength) return false;
+  int meeting;
+  if (!meetInTheMiddle(source, target, g, scratch, meeting)) return false;
+
+  // walk back from the meeting point to source, then forward to target
+  searchSide *sides = scratch.sides;
+  vector<int> firstHalf;
+  for (int player = meeting; player != source; player = sides[0].parents[player].player)
+    firstHalf.push_back(player);
+  for (int i = firstHalf.size() - 1; i >= 0; i--)
+    result.addConnection(g.getMovie(sides[0].parents[firstHalf[i]].movie), g.getActor(firstHalf[i]));
+  for (int player = meeting; player != target; ) {
+    const link& step = sides[1].parents[player];
+    result.addConnection(g.getMovie(step.movie), g.getActor(step.player));
+    player = step.player;
+  }
+
+  return true;
+}
+
+/**
+ * Function: findDistance
+ * ----------------------
+ * Returns the number of films on a shortest path between the two
+ * players, or -1 if it would take more than kMaxPathLength.  When the
+ * landmarks' bounds settle the question on their own, there's no search.
+ */
+
+static int findDistance(int source, int target, const graph& g, const landmarks& marks, searchScratch& scratch)
+{
+  if (source == target) return 0;
+  if (!marks.empty()) {
+    int lower = marks.lowerBound(source, target);
+    if (lower > kMaxPathLength) return -1;
+    if (lower == marks.upperBound(source, target)) return lower;
+  }
+  int meeting;
+  if (!meetInTheMiddle(source, target, g, scratch, meeting)) return -1;
+  return scratch.sides[0].depth + scratch.sides[1].depth + 1;
+}
+
+/**
+ * Function: generateShortestPath
+ * ------------------------------
+ * Prints the shortest path between the two players, or a polite
+ * message if there isn't one of kMaxPathLength films or fewer.
+ */
+
+void generateShortestPath(const string& player1, const string& player2, const graph& g, const landmarks& marks,
+                          searchScratch& scratch)
+{
+  path result(player1);
+  if (findShortestPath(g.lookupActor(player1), g.lookupActor(player2), g, marks, scratch, result))
+    cout << result << endl;
+  else
+    cout << "No path between those two people could be found." << endl;
+}
+
+/**
+ * Function: millisecondsSince
+ * ---------------------------
+ * Returns the time elapsed since start, for --timing's reports.
+ */
+
+static double millisecondsSince(chrono::steady_clock::time_point start)
+{
+  return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+/**
+ * Function: parseLoadPolicy
+ * -------------------------
+ * Translates a comma-separated list of load policy names (prefault,
+ * willneed, random, lock and hugepages, or lazy for none of them) into
+ * imdb load policy flags.  Returns false if any name isn't recognized.
+ */
+
+static bool parseLoadPolicy(const char *names, int& loadPolicy)
+{
+  static const struct { const char *name; int flag; } kPolicies[] = {
+    { "lazy", 0 }, { "prefault", imdb::kPrefault }, { "willneed", imdb::kWillNeed },
+    { "random", imdb::kRandom }, { "lock", imdb::kLock }, { "hugepages", imdb::kHugePages },
+  };
+
+  loadPolicy = 0;
+  string list = names;
+  size_t start = 0;
+  while (start <= list.size()) {
+    size_t end = list.find(',', start);
+    if (end == string::npos) end = list.size();
+    string name = list.substr(start, end - start);
+    bool found = false;
+    for (size_t i = 0; i < sizeof(kPolicies) / sizeof(kPolicies[0]) && !found; i++) {
+      if (name != kPolicies[i].name) continue;
+      loadPolicy |= kPolicies[i].flag;
+      found = true;
+    }
+    if (!found) return false;
+    start = end + 1;
+  }
+  return true;
+}
+
+/**
+ * Constant: kDefaultLandmarks
+ * ---------------------------
+ * How many landmarks --build-landmarks chooses unless told otherwise.
+ */
+
+static const int kDefaultLandmarks = 16;
+
+/**
+ * Constants: kPairsPerBlock, kPairsPerClaim
+ * -----------------------------------------
+ * Batch mode reads, answers and writes its input a block of pairs at a
+ * time, so memory stays bounded however long the input is.  Within a
+ * block, worker threads claim kPairsPerClaim pairs at a time.
+ */
+
+static const int kPairsPerBlock = 1 << 16;
+static const int kPairsPerClaim = 64;
+
+/**
+ * Struct: pathQuery
+ * -----------------
+ * One line of batch input, and its answer: the number of films
+ * separating the two players, -1 if that's more than kMaxPathLength,
+ * or -2 if either player isn't in the database.
+ */
+
+struct pathQuery {
+  string source;
+  string target;
+  int distance;
+};
+
+/**
+ * Function: answerQueries
+ * -----------------------
+ * The body of a batch worker, which keeps claiming unanswered queries
+ * until there are none left.  The imdb and graph are only ever read, so
+ * workers share them freely; each has a scratch of its own.
+ */
+
+static void answerQueries(vector<pathQuery> *queries, atomic<size_t> *next, const graph *g,
+                          const landmarks *marks, searchScratch *scratch)
+{
+  while (true) {
+    size_t first = next->fetch_add(kPairsPerClaim);
+    if (first >= queries->size()) return;
+    size_t last = min(first + kPairsPerClaim, queries->size());
+    for (size_t i = first; i < last; i++) {
+      pathQuery& query = (*queries)[i];
+      int source = g->lookupActor(query.source);
+      int target = g->lookupActor(query.target);
+      query.distance = source == -1 || target == -1 ? -2 : findDistance(source, target, *g, *marks, *scratch);
+    }
+  }
+}
+
+/**
+ * Function: runBatch
+ * ------------------
+ * Answers every pair in the specified file, one tab-separated pair
+ * per line, across numThreads threads, and prints each pair followed by
+ * its distance, in input order.  Blank lines are skipped.  Returns false
+ * (after saying why) if the file can't be read or a line isn't a pair.
+ * If timing is true, how long the first block took is reported on cerr.
+ */
+
+static bool runBatch(const char *fileName, int numThreads, const graph& g, const landmarks& marks, bool timing)
+{
+  ifstream in(fileName);
+  if (!in) {
+    cerr << "Couldn't open \"" << fileName << "\"." << endl;
+    return false;
+  }
+
+  vector<searchScratch> scratch(numThreads);
+  for (int t = 0; t < numThreads; t++) initScratch(scratch[t], g);
+
+  vector<pathQuery> queries;
+  string line, output;
+  long lineNumber = 0;
+  bool done = false;
+  bool firstBlock = true;
+  while (!done) {
+    queries.clear();
+    while (queries.size() < (size_t) kPairsPerBlock) {
+      if (!getline(in, line)) { done = true; break; }
+      lineNumber++;
+      if (!line.empty() && line[line.size() - 1] == '\r') line.resize(line.size() - 1);
+      if (line.empty()) continue;
+      size_t tab = line.find('\t');
+      if (tab == string::npos) {
+        cerr << fileName << ":" << lineNumber << ": expected two names separated by a tab." << endl;
+        return false;
+      }
+      pathQuery query = { line.substr(0, tab), line.substr(tab + 1), -2 };
+      queries.push_back(query);
+    }
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    atomic<size_t> next(0);
+    vector<thread> workers;
+    for (int t = 0; t < numThreads; t++)
+      workers.push_back(thread(answerQueries, &queries, &next, &g, &marks, &scratch[t]));
+    for (int t = 0; t < numThreads; t++) workers[t].join();
+    if (timing && firstBlock)
+      cerr << "first block: " << millisecondsSince(start) << " ms for " << queries.size() << " pairs" << endl;
+    firstBlock = false;
+
+    output.clear();
+    for (size_t i = 0; i < queries.size(); i++) {
+      output += queries[i].source;
+      output += '\t';
+      output += queries[i].target;
+      output += '\t';
+      output += to_string(queries[i].distance);
+      output += '\n';
+    }
+    cout.write(output.data(), output.size());
+  }
+
+  cout.flush();
+  return true;
+}
 
 /**
  * Serves as the main entry point for the six-degrees executable.
- * There are no parameters to speak of.
+ *
+ * With no arguments it plays interactively.  With
+ *
+ *    six-degrees --batch PAIRS [-j THREADS]
+ *
+ * it instead answers every pair in PAIRS (see runBatch), sharing the
+ * work among THREADS threads (0: one per core; the default is 1).
+ *
+ *    six-degrees --build-landmarks FILE [--num-landmarks N]
+ *
+ * chooses N landmarks (kDefaultLandmarks by default), computes their
+ * distances to everyone, and saves them to FILE, which either of the
+ * other modes can then be pointed at with --landmarks FILE.
+ *
+ * In any mode, --load POLICY chooses how the data files are brought into
+ * memory (see parseLoadPolicy and imdb's load policy flags), and --timing
+ * reports on cerr how long startup took and how long the first query took.
  *
  * @param argc the number of tokens passed to the command line to
- *             invoke this executable.  It's completely ignored
- *             here, because we don't expect any arguments.
+ *             invoke this executable.
  * @param argv the C strings making up the full command line.
  *             We expect argv[0] to be logically equivalent to
  *             "six-degrees" (or whatever absolute path was used to
- *             invoke the program), but otherwise these are ignored
- *             as well.
+ *             invoke the program).  Any argument that isn't an
+ *             option is passed along to determinePathToData.
  * @return 0 if the program ends normally, and undefined otherwise.
  */
 
 int main(int argc, const char *argv[])
 {
-  imdb db(determinePathToData(argv[1])); // inlined in imdb-utils.h
+  const char *dataPath = NULL;
+  const char *batchFileName = NULL;
+  const char *landmarkFileName = NULL;
+  bool buildLandmarks = false;
+  int numLandmarks = kDefaultLandmarks;
+  int numThreads = 1;
+  int loadPolicy = 0;
+  bool timing = false;
+  bool usage = false;
+  for (int i = 1; i < argc && !usage; i++) {
+    if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc) {
+      batchFileName = argv[++i];
+    } else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+      numThreads = atoi(argv[++i]);
+      if (numThreads < 0) usage = true;
+      if (numThreads == 0) numThreads = max(1u, thread::hardware_concurrency());
+    } else if ((strcmp(argv[i], "--landmarks") == 0 || strcmp(argv[i], "--build-landmarks") == 0) &&
+               i + 1 < argc) {
+      buildLandmarks = strcmp(argv[i], "--build-landmarks") == 0;
+      landmarkFileName = argv[++i];
+    } else if (strcmp(argv[i], "--num-landmarks") == 0 && i + 1 < argc) {
+      numLandmarks = atoi(argv[++i]);
+      if (numLandmarks <= 0) usage = true;
+    } else if (strcmp(argv[i], "--load") == 0 && i + 1 < argc) {
+      if (!parseLoadPolicy(argv[++i], loadPolicy)) usage = true;
+    } else if (strcmp(argv[i], "--timing") == 0) {
+      timing = true;
+    } else if (argv[i][0] != '-') {
+      dataPath = argv[i];
+    } else {
+      usage = true;
+    }
+  }
+  if (usage) {
+    cerr << "Usage: six-degrees [--load POLICY[,POLICY...]] [--timing] [--landmarks FILE] [--batch PAIRS [-j THREADS]]" << endl;
+    cerr << "       six-degrees --build-landmarks FILE [--num-landmarks N]" << endl;
+    cerr << "       where each POLICY is lazy, prefault, willneed, random, lock or hugepages" << endl;
+    return 1;
+  }
+
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+  imdb db(determinePathToData(dataPath), loadPolicy); // inlined in imdb-utils.h
   if (!db.good()) {
     cout << "Failed to properly initialize the imdb database." << endl;
     cout << "Please check to make sure the source files exist and that you have permission to read them." << endl;
     return 1;
   }
+  double mapTime = millisecondsSince(start);
+  db.buildNameIndex();
+  graph g(db);
+
+  landmarks marks;
+  if (buildLandmarks) {
+    marks.build(g, numLandmarks);
+    if (!marks.save(landmarkFileName)) {
+      cerr << "Couldn't write the landmarks to \"" << landmarkFileName << "\"." << endl;
+      return 1;
+    }
+    cout << "Saved " << marks.size() << " landmarks to \"" << landmarkFileName << "\"." << endl;
+    return 0;
+  }
+  if (landmarkFileName != NULL && !marks.load(landmarkFileName, g)) {
+    cerr << "Couldn't load landmarks for this database from \"" << landmarkFileName << "\"." << endl;
+    return 1;
+  }
+
+
+  searchScratch scratch;
+  initScratch(scratch, g);
+  if (timing)
+    cerr << "startup: " << millisecondsSince(start) << " ms (" << mapTime << " ms loading the data files)" << endl;
+  if (batchFileName != NULL) return runBatch(batchFileName, numThreads, g, marks, timing) ? 0 : 1;
   
   while (true) {
     string source = promptForActor("Actor or actress", db);
@@ -110,7 +561,9 @@ int main(int argc, const char *argv[])
     if (source == target) {
       cout << "Good one.  This is only interesting if you specify two different people." << endl;
     } else {
-      generateShortestPath(source, target, db);
+      chrono::steady_clock::time_point asked = chrono::steady_clock::now();
+      generateShortestPath(source, target, g, marks, scratch);
+      if (timing) cerr << "query: " << millisecondsSince(asked) << " ms" << endl;
     }
   }
   